@@ -0,0 +1,139 @@
+#include "BenchUtils.h"
+
+#include <thread>
+
+namespace Bench
+{
+	TickCalibration::TickCalibration()
+	{
+		const auto clockBegin = Clock::now();
+		const u64 tickBegin = ReadTicks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		const u64 tickEnd = ReadTicks();
+		const double ns = std::chrono::duration<double, std::nano>(Clock::now() - clockBegin).count();
+		m_NsPerTick = ns / static_cast<double>(tickEnd - tickBegin);
+
+		constexpr u32 SAMPLES = 100000;
+		u64 total = 0;
+		for (u32 i = 0; i < SAMPLES; i++)
+		{
+			const u64 t0 = ReadTicks();
+			const u64 t1 = ReadTicks();
+			total += t1 - t0;
+		}
+		m_OverheadTicks = static_cast<double>(total) / SAMPLES;
+	}
+
+	void JsonWriter::BeginObject(std::string_view key)
+	{
+		Separator();
+		if (!key.empty())
+		{
+			Key(key);
+		}
+		fputc('{', m_Out);
+		m_Depth++;
+		m_NeedComma = false;
+	}
+
+	void JsonWriter::EndObject()
+	{
+		m_Depth--;
+		fputc('\n', m_Out);
+		for (u32 i = 0; i < m_Depth; i++)
+			fputs("  ", m_Out);
+		fputc('}', m_Out);
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::BeginArray(std::string_view key)
+	{
+		Separator();
+		Key(key);
+		fputc('[', m_Out);
+		m_Depth++;
+		m_NeedComma = false;
+	}
+
+	void JsonWriter::EndArray()
+	{
+		m_Depth--;
+		fputc('\n', m_Out);
+		for (u32 i = 0; i < m_Depth; i++)
+			fputs("  ", m_Out);
+		fputc(']', m_Out);
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::Field(std::string_view key, double val)
+	{
+		Separator();
+		Key(key);
+		fprintf(m_Out, "%.3f", val);
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::Field(std::string_view key, u64 val)
+	{
+		Separator();
+		Key(key);
+		fprintf(m_Out, "%llu", static_cast<unsigned long long>(val));
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::Field(std::string_view key, std::string_view val)
+	{
+		Separator();
+		Key(key);
+		String(val);
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::Field(std::string_view key, bool val)
+	{
+		Separator();
+		Key(key);
+		fputs(val ? "true" : "false", m_Out);
+		m_NeedComma = true;
+	}
+
+	void JsonWriter::Finish()
+	{
+		fputc('\n', m_Out);
+		fflush(m_Out);
+	}
+
+	void JsonWriter::Separator()
+	{
+		if (m_NeedComma)
+		{
+			fputc(',', m_Out);
+		}
+		if (m_Depth > 0)
+		{
+			fputc('\n', m_Out);
+			for (u32 i = 0; i < m_Depth; i++)
+				fputs("  ", m_Out);
+		}
+	}
+
+	void JsonWriter::Key(std::string_view key)
+	{
+		String(key);
+		fputs(": ", m_Out);
+	}
+
+	void JsonWriter::String(std::string_view val)
+	{
+		fputc('"', m_Out);
+		for (const char c : val)
+		{
+			if (c == '"' || c == '\\')
+			{
+				fputc('\\', m_Out);
+			}
+			fputc(c, m_Out);
+		}
+		fputc('"', m_Out);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define BENCH_HAS_TSC
+#endif
+
+namespace Bench
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Cheapest available timestamp. Falls back to steady_clock nanoseconds
+	// on targets without a time stamp counter.
+	inline u64 ReadTicks()
+	{
+#ifdef BENCH_HAS_TSC
+		return __rdtsc();
+#else
+		return static_cast<u64>(Clock::now().time_since_epoch().count());
+#endif
+	}
+
+	// Converts ReadTicks() deltas to nanoseconds. Calibrated once against
+	// steady_clock; also measures the cost of an empty ReadTicks() pair so
+	// fine-grained sections can subtract it.
+	class TickCalibration
+	{
+	public:
+		TickCalibration();
+
+		double ToNs(double ticks) const { return ticks * m_NsPerTick; }
+
+		double GetOverheadTicks() const { return m_OverheadTicks; }
+
+	private:
+		double m_NsPerTick = 1.0;
+		double m_OverheadTicks = 0.0;
+	};
+
+	inline double SecondsSince(Clock::time_point begin)
+	{
+		return std::chrono::duration<double>(Clock::now() - begin).count();
+	}
+
+	// Minimal streaming JSON writer, enough for flat benchmark reports
+	class JsonWriter
+	{
+	public:
+		explicit JsonWriter(FILE* out) : m_Out{ out } {}
+
+		void BeginObject(std::string_view key = {});
+		void EndObject();
+
+		void BeginArray(std::string_view key);
+		void EndArray();
+
+		void Field(std::string_view key, double val);
+		void Field(std::string_view key, u64 val);
+		void Field(std::string_view key, std::string_view val);
+		void Field(std::string_view key, bool val);
+		// A string literal would otherwise pick the bool overload
+		void Field(std::string_view key, const char* val) = delete;
+
+		void Finish();
+
+	private:
+		void Separator();
+		void Key(std::string_view key);
+		void String(std::string_view val);
+
+	private:
+		FILE* m_Out = nullptr;
+		u32 m_Depth = 0;
+		bool m_NeedComma = false;
+	};
+}
@@ -0,0 +1,1315 @@
+#include "BenchUtils.h"
+#include "../Core/AudioRateControl.h"
+#include "../Core/FrameConversion.h"
+#include "../Core/Hash.h"
+#include "../Core/Logger.h"
+#include "../Core/SpscRing.h"
+#include "../Core/TripleBuffer.h"
+#include "../NES/Movie.h"
+#include "../NES/NES.h"
+#include "../NES/NESPool.h"
+#include "../NES/RewindBuffer.h"
+#include "../NES/RunAhead.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Uncapped throughput benchmark. Runs a fixed list of ROMs for a fixed
+// number of frames and prints a JSON report to stdout so results can be
+// diffed between commits. Logging goes to stderr.
+
+static constexpr u64 DEFAULT_FRAMES = 1800;
+static constexpr u64 DEFAULT_WARMUP_FRAMES = 120;
+static constexpr u32 CONVERSION_ITERATIONS = 2000;
+static constexpr u32 BUS_READ_ITERATIONS = 1 << 24;
+static constexpr u32 SAVE_STATE_ITERATIONS = 20000;
+static constexpr u64 SAVE_STATE_REPLAY_FRAMES = 60;
+static constexpr u64 REWIND_RECORD_FRAMES = 1200;
+static constexpr u64 REWIND_STEPS = 300;
+// Less than a keyframe group takes on most games, so making room for a
+// delta drops the group it was encoded against
+static constexpr RewindConfig SMALL_REWIND_CONFIG = { .seconds = 5, .memoryBudget = 8 << 10, .keyframeInterval = 60 };
+static constexpr u64 RUN_AHEAD_FRAMES = 300;
+static constexpr u64 FRAME_SKIP_FRAMES = 600;
+static constexpr u32 FRAME_SKIP = 3;
+static constexpr u64 AUDIO_FRAMES = 600;
+static constexpr u32 AUDIO_SAMPLE_RATE = 48000;
+static constexpr u32 ROM_LOAD_ITERATIONS = 500;
+static constexpr u32 FORK_ITERATIONS = 2000;
+static constexpr u32 BRANCH_ITERATIONS = 200;
+static constexpr u64 MOVIE_FRAMES = 600;
+static constexpr u64 STATE_HASH_FRAMES = 300;
+static constexpr u64 STATE_HASH_CHECK_INTERVAL = 30;
+static constexpr u32 TRIPLE_BUFFER_FRAMES = 20000;
+static constexpr u64 AUDIO_RING_SAMPLES = 1ull << 22;
+static constexpr usize AUDIO_RING_CAPACITY = 4096;
+static constexpr u64 RATE_CONTROL_FRAMES = 60 * 600;
+// Device clocks off from the nominal sample rate by this much, either way
+static constexpr Array<double, 3> RATE_CONTROL_DRIFTS = { -0.003, 0.0, 0.003 };
+static constexpr usize POOL_INSTANCES = 32;
+static constexpr u64 POOL_FRAMES = 120;
+static constexpr const char* DEFAULT_ROM_DIR = "Roms";
+
+struct BenchOptions
+{
+	std::vector<std::filesystem::path> roms;
+	u64 frames = DEFAULT_FRAMES;
+	u64 warmupFrames = DEFAULT_WARMUP_FRAMES;
+};
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: nes-bench [roms...] [options]\n"
+		"  --frames <n>   Measured frames per ROM (default %llu)\n"
+		"  --warmup <n>   Unmeasured frames run first (default %llu)\n"
+		"  --list <file>  Read ROM paths from a file, one per line\n"
+		"With no ROMs given, every .nes file in %s/ is used in sorted order.\n",
+		static_cast<unsigned long long>(DEFAULT_FRAMES),
+		static_cast<unsigned long long>(DEFAULT_WARMUP_FRAMES),
+		DEFAULT_ROM_DIR);
+}
+
+static bool ReadRomList(const char* path, std::vector<std::filesystem::path>& roms)
+{
+	std::ifstream inf{ path };
+	if (!inf)
+	{
+		LOG_ERROR("Failed to open ROM list %s", path);
+		return false;
+	}
+	std::string line;
+	while (std::getline(inf, line))
+	{
+		if (!line.empty() && line[0] != '#')
+		{
+			roms.emplace_back(line);
+		}
+	}
+	return true;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		if (std::strcmp(arg, "--frames") == 0 && i + 1 < argc)
+		{
+			options.frames = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(arg, "--warmup") == 0 && i + 1 < argc)
+		{
+			options.warmupFrames = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(arg, "--list") == 0 && i + 1 < argc)
+		{
+			if (!ReadRomList(argv[++i], options.roms))
+				return false;
+		}
+		else if (arg[0] != '-')
+		{
+			options.roms.emplace_back(arg);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (options.roms.empty())
+	{
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(DEFAULT_ROM_DIR, ec))
+		{
+			if (entry.path().extension() == ".nes")
+			{
+				options.roms.push_back(entry.path());
+			}
+		}
+		std::sort(options.roms.begin(), options.roms.end());
+	}
+	return true;
+}
+
+// Emulated frames per second and CPU cycles per second through the
+// public NES::StepFrame path
+static void BenchThroughput(NES& nes, const BenchOptions& options, Bench::JsonWriter& json)
+{
+	json.Field("scheduler", std::string_view{ nes.GetSchedulerMode() == SchedulerMode::CatchUp ? "catchup" : "lockstep" });
+	json.Field("cpu_mode", std::string_view{ nes.GetCpuExecutionMode() == CpuExecutionMode::Instruction ? "instruction" : "cycle" });
+
+	const u64 cyclesBegin = nes.GetCpu().GetCycle();
+	const auto begin = Bench::Clock::now();
+
+	for (u64 frame = 0; frame < options.frames; frame++)
+	{
+		nes.StepFrame();
+	}
+
+	const double seconds = Bench::SecondsSince(begin);
+	const u64 cycles = nes.GetCpu().GetCycle() - cyclesBegin;
+
+	json.Field("fps", options.frames / seconds);
+	json.Field("speed", options.frames / seconds * NES::FRAME_TIME);
+	json.Field("ns_per_frame", seconds * 1e9 / options.frames);
+	json.Field("cpu_cycles_per_sec", cycles / seconds);
+}
+
+// Splits time between the CPU and PPU by stepping them the same way
+// NES::Update does and timestamping around each call. The timestamp
+// overhead is measured up front and subtracted.
+static void BenchSubsystems(NES& nes, const BenchOptions& options,
+							const Bench::TickCalibration& calibration,
+							Bench::JsonWriter& json)
+{
+	// Pays off any dots the catch-up scheduler still owes
+	const SchedulerMode scheduler = nes.GetSchedulerMode();
+	nes.SetSchedulerMode(SchedulerMode::Lockstep);
+
+	CPU& cpu = nes.GetCpu();
+	PPU& ppu = nes.GetPpu();
+
+	u64 cpuTicks = 0;
+	u64 ppuTicks = 0;
+	u64 cpuCycles = 0;
+
+	for (u64 frame = 0; frame < options.frames; frame++)
+	{
+		while (!ppu.FramebufferReady())
+		{
+			const u64 t0 = Bench::ReadTicks();
+			cpu.PerformCycle();
+			const u64 t1 = Bench::ReadTicks();
+			ppu.PerformCycle();
+			ppu.PerformCycle();
+			ppu.PerformCycle();
+			const u64 t2 = Bench::ReadTicks();
+
+			cpuTicks += t1 - t0;
+			ppuTicks += t2 - t1;
+			cpuCycles++;
+		}
+		ppu.ClearFramebufferReady();
+	}
+
+	const double overhead = calibration.GetOverheadTicks();
+	const double cpuPerCycle = std::max(0.0, static_cast<double>(cpuTicks) / cpuCycles - overhead);
+	const double ppuPerCycle = std::max(0.0, static_cast<double>(ppuTicks) / cpuCycles - overhead) / 3.0;
+
+	// The sections after this one measure the configured scheduler
+	nes.SetSchedulerMode(scheduler);
+
+	json.Field("ns_per_cpu_cycle", calibration.ToNs(cpuPerCycle));
+	json.Field("ns_per_ppu_cycle", calibration.ToNs(ppuPerCycle));
+}
+
+// Cost of one CPU bus read through the page table and through the full
+// address decode. Only RAM and PRG-ROM addresses are used so neither
+// path has side effects.
+static void BenchBusRead(NES& nes, Bench::JsonWriter& json)
+{
+	CPUBus& bus = nes.GetCpuBus();
+
+	std::vector<u16> addrs(4096);
+	u32 seed = 0x9E3779B9;
+	for (usize i = 0; i < addrs.size(); i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		addrs[i] = (i & 1) ? 0x8000 | (seed >> 17) : (seed >> 21);
+	}
+	const usize mask = addrs.size() - 1;
+
+	u32 checksum = 0;
+
+	auto begin = Bench::Clock::now();
+	for (u32 i = 0; i < BUS_READ_ITERATIONS; i++)
+	{
+		checksum += bus.Read(addrs[i & mask]);
+	}
+	const double pageTableNs = Bench::SecondsSince(begin) * 1e9 / BUS_READ_ITERATIONS;
+
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < BUS_READ_ITERATIONS; i++)
+	{
+		checksum += bus.ReadSlow(addrs[i & mask]);
+	}
+	const double decodeNs = Bench::SecondsSince(begin) * 1e9 / BUS_READ_ITERATIONS;
+
+	json.BeginObject("bus_read");
+	json.Field("page_table_ns", pageTableNs);
+	json.Field("decode_ns", decodeNs);
+	json.Field("checksum", static_cast<u64>(checksum));
+	json.EndObject();
+}
+
+static u64 HashFramebuffer(const u16* framebuffer)
+{
+	return Hash::Hash64(framebuffer, PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT * sizeof(u16));
+}
+
+// Action for one instance on one frame, so instances diverge but every
+// run of the pool sees the same inputs
+static u8 PoolAction(u64 frame, usize instance)
+{
+	u32 seed = static_cast<u32>((frame / 8) * 2654435761u + instance * 40503u);
+	seed ^= seed >> 15;
+	return static_cast<u8>(seed * 2246822519u >> 24);
+}
+
+// Per-frame cost of the incremental state hash against saving the whole
+// state and hashing that, both taken right after each frame the way
+// replays use them. Every so often the incremental hash is checked
+// against one rebuilt from scratch by a fresh instance loading the state.
+static void BenchStateHash(NES& nes, Bench::JsonWriter& json)
+{
+	std::vector<u8> state(nes.GetSaveStateSize());
+	auto fresh = std::make_unique<NES>();
+	if (!fresh->LoadROM(nes.GetCartridge().GetImage()))
+		return;
+
+	double incrementalSeconds = 0.0;
+	double fullSeconds = 0.0;
+	u64 checksum = 0;
+	bool match = true;
+	for (u64 frame = 0; frame < STATE_HASH_FRAMES; frame++)
+	{
+		nes.SetButtonsState(PoolAction(frame, 0));
+		nes.StepFrame();
+
+		auto begin = Bench::Clock::now();
+		nes.SaveState(state);
+		checksum += Hash::Hash64(state.data(), state.size());
+		fullSeconds += Bench::SecondsSince(begin);
+
+		begin = Bench::Clock::now();
+		const u64 hash = nes.GetStateHash();
+		incrementalSeconds += Bench::SecondsSince(begin);
+		checksum += hash;
+
+		if (frame % STATE_HASH_CHECK_INTERVAL == 0)
+		{
+			match = match && fresh->LoadState(state) == SaveStateResult::Success && fresh->GetStateHash() == hash;
+		}
+	}
+	nes.SetButtonsState(0);
+
+	if (!match)
+	{
+		LOG_ERROR("Incremental state hash differs from a full rehash (%llu frames)",
+				  static_cast<unsigned long long>(STATE_HASH_FRAMES));
+	}
+
+	json.BeginObject("state_hash");
+	json.Field("frames", STATE_HASH_FRAMES);
+	json.Field("incremental_ns", incrementalSeconds * 1e9 / STATE_HASH_FRAMES);
+	json.Field("full_ns", fullSeconds * 1e9 / STATE_HASH_FRAMES);
+	json.Field("checksum", checksum);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Save and load cost on their own, then whether loading a state and
+// replaying the same frames reproduces them
+static void BenchSaveState(NES& nes, Bench::JsonWriter& json)
+{
+	std::vector<u8> state(nes.GetSaveStateSize());
+	std::vector<u8> check(nes.GetSaveStateSize());
+
+	auto begin = Bench::Clock::now();
+	for (u32 i = 0; i < SAVE_STATE_ITERATIONS; i++)
+	{
+		nes.SaveState(state);
+	}
+	const double saveNs = Bench::SecondsSince(begin) * 1e9 / SAVE_STATE_ITERATIONS;
+
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < SAVE_STATE_ITERATIONS; i++)
+	{
+		nes.LoadState(state);
+	}
+	const double loadNs = Bench::SecondsSince(begin) * 1e9 / SAVE_STATE_ITERATIONS;
+
+	nes.SaveState(check);
+	const bool roundTrip = state == check;
+
+	u64 firstHash = 0;
+	for (u64 frame = 0; frame < SAVE_STATE_REPLAY_FRAMES; frame++)
+	{
+		nes.StepFrame();
+		firstHash = (firstHash * 31) ^ HashFramebuffer(nes.GetFramebuffer());
+	}
+	nes.LoadState(state);
+	u64 replayHash = 0;
+	for (u64 frame = 0; frame < SAVE_STATE_REPLAY_FRAMES; frame++)
+	{
+		nes.StepFrame();
+		replayHash = (replayHash * 31) ^ HashFramebuffer(nes.GetFramebuffer());
+	}
+	const bool replay = firstHash == replayHash;
+
+	if (!roundTrip || !replay)
+	{
+		LOG_ERROR("Save state mismatch (round trip %d, replay %d)", roundTrip, replay);
+	}
+
+	json.BeginObject("save_state");
+	json.Field("size", static_cast<u64>(state.size()));
+	json.Field("save_ns", saveNs);
+	json.Field("load_ns", loadNs);
+	json.Field("round_trip_match", roundTrip);
+	json.Field("replay_match", replay);
+	json.EndObject();
+}
+
+// Records with the given rewind settings, then steps back through the
+// history checking each rewound frame against the one first emulated.
+// rewind_step_ns only covers RewindBuffer::Rewind (decode and load).
+static void BenchRewind(NES& nes, const char* name, const RewindConfig& config, Bench::JsonWriter& json)
+{
+	RewindBuffer rewind{ nes.GetSaveStateSize(), config };
+	std::vector<u64> hashes(REWIND_RECORD_FRAMES);
+
+	double pushSeconds = 0.0;
+	for (u64 frame = 0; frame < REWIND_RECORD_FRAMES; frame++)
+	{
+		const auto begin = Bench::Clock::now();
+		rewind.Push(nes);
+		pushSeconds += Bench::SecondsSince(begin);
+
+		nes.StepFrame();
+		hashes[frame] = HashFramebuffer(nes.GetFramebuffer());
+	}
+	const usize memoryUsed = rewind.GetMemoryUsed();
+	const usize snapshots = rewind.GetSnapshotCount();
+
+	double rewindSeconds = 0.0;
+	u64 steps = 0;
+	bool match = true;
+	for (; steps < REWIND_STEPS && steps < snapshots; steps++)
+	{
+		const auto begin = Bench::Clock::now();
+		const bool rewound = rewind.Rewind(nes);
+		rewindSeconds += Bench::SecondsSince(begin);
+
+		nes.StepFrame();
+		match = match && rewound && HashFramebuffer(nes.GetFramebuffer()) == hashes[REWIND_RECORD_FRAMES - 1 - steps];
+	}
+
+	if (!match)
+	{
+		LOG_ERROR("Rewound frames don't match the recorded ones in %s (%llu steps)", name,
+				  static_cast<unsigned long long>(steps));
+	}
+
+	auto average = [](u64 bytes, u64 count) { return count ? static_cast<double>(bytes) / count : 0.0; };
+
+	json.BeginObject(name);
+	json.Field("snapshots", static_cast<u64>(snapshots));
+	json.Field("memory_used", static_cast<u64>(memoryUsed));
+	json.Field("capacity", static_cast<u64>(rewind.GetCapacity()));
+	json.Field("state_size", static_cast<u64>(nes.GetSaveStateSize()));
+	json.Field("avg_keyframe_bytes", average(rewind.GetKeyframeBytes(), rewind.GetKeyframesPushed()));
+	json.Field("avg_delta_bytes", average(rewind.GetDeltaBytes(), rewind.GetDeltasPushed()));
+	json.Field("push_ns", pushSeconds * 1e9 / REWIND_RECORD_FRAMES);
+	json.Field("rewind_step_ns", steps ? rewindSeconds * 1e9 / steps : 0.0);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Branching the emulator for tree search: Fork and ForkInto on their own,
+// then a branch followed by one frame (which pays for the pages the frame
+// writes) against restoring a save state and running the same frame.
+// Both branch styles have to produce the same frame.
+static void BenchFork(NES& nes, Bench::JsonWriter& json)
+{
+	auto begin = Bench::Clock::now();
+	for (u32 i = 0; i < FORK_ITERATIONS; i++)
+	{
+		std::unique_ptr<NES> child = nes.Fork();
+	}
+	const double forkNs = Bench::SecondsSince(begin) * 1e9 / FORK_ITERATIONS;
+
+	NES child{};
+	nes.ForkInto(child);
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < FORK_ITERATIONS; i++)
+	{
+		nes.ForkInto(child);
+	}
+	const double forkIntoNs = Bench::SecondsSince(begin) * 1e9 / FORK_ITERATIONS;
+
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < BRANCH_ITERATIONS; i++)
+	{
+		nes.ForkInto(child);
+		child.StepFrame();
+	}
+	const double forkBranchNs = Bench::SecondsSince(begin) * 1e9 / BRANCH_ITERATIONS;
+	const u64 forkHash = HashFramebuffer(child.GetFramebuffer());
+
+	std::vector<u8> state(nes.GetSaveStateSize());
+	nes.SaveState(state);
+	NES restored{};
+	nes.ForkInto(restored);
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < BRANCH_ITERATIONS; i++)
+	{
+		restored.LoadState(state);
+		restored.StepFrame();
+	}
+	const double loadBranchNs = Bench::SecondsSince(begin) * 1e9 / BRANCH_ITERATIONS;
+	const bool match = HashFramebuffer(restored.GetFramebuffer()) == forkHash;
+
+	if (!match)
+	{
+		LOG_ERROR("Forked frame differs from the save state one (%llu branches)",
+				  static_cast<unsigned long long>(BRANCH_ITERATIONS));
+	}
+
+	json.BeginObject("fork");
+	json.Field("fork_state_size", static_cast<u64>(nes.GetForkStateSize()));
+	json.Field("save_state_size", static_cast<u64>(nes.GetSaveStateSize()));
+	json.Field("fork_ns", forkNs);
+	json.Field("fork_into_ns", forkIntoNs);
+	json.Field("fork_branch_frame_ns", forkBranchNs);
+	json.Field("load_branch_frame_ns", loadBranchNs);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Cost of a displayed frame with one frame of run-ahead against a plain
+// one, and of a frame emulated with video off. The frame shown after step
+// k with run-ahead has to be the plain run's frame k + 1.
+static void BenchRunAhead(NES& nes, Bench::JsonWriter& json)
+{
+	std::vector<u8> start(nes.GetSaveStateSize());
+	nes.SaveState(start);
+
+	std::vector<u64> hashes(RUN_AHEAD_FRAMES + 1);
+	auto begin = Bench::Clock::now();
+	for (u64 frame = 0; frame <= RUN_AHEAD_FRAMES; frame++)
+	{
+		nes.StepFrame();
+		hashes[frame] = HashFramebuffer(nes.GetFramebuffer());
+	}
+	const double plainNs = Bench::SecondsSince(begin) * 1e9 / (RUN_AHEAD_FRAMES + 1);
+
+	nes.LoadState(start);
+	nes.SetVideoOutput(false);
+	begin = Bench::Clock::now();
+	for (u64 frame = 0; frame < RUN_AHEAD_FRAMES; frame++)
+	{
+		nes.StepFrame();
+	}
+	const double hiddenNs = Bench::SecondsSince(begin) * 1e9 / RUN_AHEAD_FRAMES;
+	nes.SetVideoOutput(true);
+
+	nes.LoadState(start);
+	RunAhead runAhead{ nes.GetSaveStateSize() };
+	bool match = true;
+	double runAheadSeconds = 0.0;
+	for (u64 frame = 0; frame < RUN_AHEAD_FRAMES; frame++)
+	{
+		begin = Bench::Clock::now();
+		runAhead.StepFrame(nes);
+		runAheadSeconds += Bench::SecondsSince(begin);
+		match = match && HashFramebuffer(nes.GetFramebuffer()) == hashes[frame + 1];
+	}
+	const double runAheadNs = runAheadSeconds * 1e9 / RUN_AHEAD_FRAMES;
+
+	if (!match)
+	{
+		LOG_ERROR("Run-ahead frames don't match the plain run (%llu frames)",
+				  static_cast<unsigned long long>(RUN_AHEAD_FRAMES));
+	}
+
+	json.BeginObject("run_ahead");
+	json.Field("frames", RUN_AHEAD_FRAMES);
+	json.Field("plain_frame_ns", plainNs);
+	json.Field("hidden_frame_ns", hiddenNs);
+	json.Field("run_ahead_frame_ns", runAheadNs);
+	json.Field("cost_ratio", plainNs > 0.0 ? runAheadNs / plainNs : 0.0);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Speed with FRAME_SKIP frames skipped per rendered one against rendering
+// every frame, from the same state with the same input. Every rendered
+// frame and the state after every frame have to match the plain run.
+static void BenchFrameSkip(NES& nes, Bench::JsonWriter& json)
+{
+	std::vector<u8> start(nes.GetSaveStateSize());
+	nes.SaveState(start);
+
+	std::vector<u64> frameHashes(FRAME_SKIP_FRAMES);
+	std::vector<u64> stateHashes(FRAME_SKIP_FRAMES);
+	auto run = [&](bool skipping, bool& match)
+	{
+		nes.LoadState(start);
+		nes.SetFrameSkip(skipping ? FRAME_SKIP : 0);
+		match = true;
+
+		double seconds = 0.0;
+		for (u64 frame = 0; frame < FRAME_SKIP_FRAMES; frame++)
+		{
+			nes.SetButtonsState(PoolAction(frame, 0));
+			const auto begin = Bench::Clock::now();
+			nes.StepFrame();
+			seconds += Bench::SecondsSince(begin);
+
+			// Hashes are taken outside the timed part
+			const u64 stateHash = nes.GetStateHash();
+			if (!skipping)
+			{
+				frameHashes[frame] = HashFramebuffer(nes.GetFramebuffer());
+				stateHashes[frame] = stateHash;
+				continue;
+			}
+			const bool rendered = frame % (FRAME_SKIP + 1) == 0;
+			match = match && nes.FrameRendered() == rendered && stateHash == stateHashes[frame] &&
+					(!rendered || HashFramebuffer(nes.GetFramebuffer()) == frameHashes[frame]);
+		}
+		nes.SetFrameSkip(0);
+		nes.SetButtonsState(0);
+		return seconds > 0.0 ? FRAME_SKIP_FRAMES / seconds : 0.0;
+	};
+
+	bool match = false;
+	const double plainFps = run(false, match);
+	const double skipFps = run(true, match);
+
+	if (!match)
+	{
+		LOG_ERROR("Frame skip changed the emulation (%llu frames)", static_cast<unsigned long long>(FRAME_SKIP_FRAMES));
+	}
+
+	json.BeginObject("frame_skip");
+	json.Field("frames", FRAME_SKIP_FRAMES);
+	json.Field("skip", static_cast<u64>(FRAME_SKIP));
+	json.Field("plain_fps", plainFps);
+	json.Field("skip_fps", skipFps);
+	json.Field("speedup", plainFps > 0.0 ? skipFps / plainFps : 0.0);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Speed with sound synthesized at AUDIO_SAMPLE_RATE against sound off,
+// from the same state with the same input. Synthesis must not change the
+// emulation, so the state after every frame has to match.
+static void BenchAudio(NES& nes, Bench::JsonWriter& json)
+{
+	std::vector<u8> start(nes.GetSaveStateSize());
+	nes.SaveState(start);
+
+	std::vector<u64> stateHashes(AUDIO_FRAMES);
+	std::vector<i16> samples(AUDIO_SAMPLE_RATE / 10);
+	u64 sampleCount = 0;
+	u64 checksum = 0;
+	auto run = [&](u32 sampleRate, bool& match)
+	{
+		nes.LoadState(start);
+		nes.SetAudioSampleRate(sampleRate);
+		match = true;
+
+		double seconds = 0.0;
+		for (u64 frame = 0; frame < AUDIO_FRAMES; frame++)
+		{
+			nes.SetButtonsState(PoolAction(frame, 0));
+			const auto begin = Bench::Clock::now();
+			nes.StepFrame();
+			const usize count = nes.ReadAudioSamples(samples);
+			seconds += Bench::SecondsSince(begin);
+
+			// Hashes are taken outside the timed part
+			const u64 stateHash = nes.GetStateHash();
+			if (sampleRate == 0)
+			{
+				stateHashes[frame] = stateHash;
+				continue;
+			}
+			match = match && stateHash == stateHashes[frame];
+			sampleCount += count;
+			checksum = Hash::Hash64(samples.data(), count * sizeof(i16), checksum);
+		}
+		nes.SetAudioSampleRate(0);
+		nes.SetButtonsState(0);
+		return seconds > 0.0 ? AUDIO_FRAMES / seconds : 0.0;
+	};
+
+	bool match = false;
+	const double silentFps = run(0, match);
+	const double audioFps = run(AUDIO_SAMPLE_RATE, match);
+
+	if (!match)
+	{
+		LOG_ERROR("Sound synthesis changed the emulation (%llu frames)", static_cast<unsigned long long>(AUDIO_FRAMES));
+	}
+
+	json.BeginObject("audio");
+	json.Field("frames", AUDIO_FRAMES);
+	json.Field("sample_rate", static_cast<u64>(AUDIO_SAMPLE_RATE));
+	json.Field("silent_fps", silentFps);
+	json.Field("audio_fps", audioFps);
+	json.Field("cost_fraction", audioFps > 0.0 ? silentFps / audioFps - 1.0 : 0.0);
+	json.Field("samples_per_frame", static_cast<double>(sampleCount) / AUDIO_FRAMES);
+	json.Field("checksum", checksum);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Time to load and validate the ROM as a shared image, mapped and read
+// into memory. Both have to see the same bytes.
+static void BenchRomLoad(const std::filesystem::path& path, Bench::JsonWriter& json)
+{
+	auto timeLoads = [&](RomLoadMode mode, std::shared_ptr<const RomImage>& image)
+	{
+		const auto begin = Bench::Clock::now();
+		for (u32 i = 0; i < ROM_LOAD_ITERATIONS; i++)
+		{
+			if (RomImage::LoadFromFile(path, image, mode) != CartridgeLoadResult::Success)
+				return 0.0;
+		}
+		return Bench::SecondsSince(begin) * 1e9 / ROM_LOAD_ITERATIONS;
+	};
+
+	std::shared_ptr<const RomImage> mapped;
+	std::shared_ptr<const RomImage> copied;
+	const double mappedNs = timeLoads(RomLoadMode::Mapped, mapped);
+	const double copyNs = timeLoads(RomLoadMode::Copy, copied);
+	if (!mapped || !copied)
+		return;
+
+	auto sameSection = [](const u8* a, const u8* b, usize size)
+	{
+		return (!a && !b) || (a && b && std::memcmp(a, b, size) == 0);
+	};
+	const bool match = mapped->GetPrgRomSize() == copied->GetPrgRomSize() &&
+					   mapped->GetChrSize() == copied->GetChrSize() &&
+					   sameSection(mapped->GetPrgRom(), copied->GetPrgRom(), copied->GetPrgRomSize()) &&
+					   sameSection(mapped->GetChrRom(), copied->GetChrRom(), copied->GetChrSize()) &&
+					   sameSection(mapped->GetTrainer(), copied->GetTrainer(), RomImage::TRAINER_SIZE);
+
+	if (!match)
+	{
+		LOG_ERROR("Mapped and copied ROM images differ for %s", path.string().c_str());
+	}
+
+	json.BeginObject("rom_load");
+	json.Field("mapped", mapped->IsMapped());
+	json.Field("mapped_ns", mappedNs);
+	json.Field("copy_ns", copyNs);
+	json.Field("match", match);
+	json.EndObject();
+}
+
+// Loads copies of the movie file at path cut short at every length, and
+// with each count in the header set to the largest there is. Every one
+// has to be turned down as InvalidFormat, without a huge allocation.
+static bool CheckCorruptMovies(const std::filesystem::path& path)
+{
+	// frameCount, resetCount and runCount in the header
+	constexpr Array<usize, 3> COUNT_OFFSETS = { 16, 20, 24 };
+
+	std::ifstream inf{ path, std::ios::binary };
+	const std::vector<u8> original{ std::istreambuf_iterator<char>(inf), std::istreambuf_iterator<char>() };
+	const std::filesystem::path corruptPath = path.string() + ".corrupt";
+
+	auto rejected = [&](const u8* data, usize size)
+	{
+		{
+			std::ofstream outf{ corruptPath, std::ios::binary | std::ios::trunc };
+			outf.write(reinterpret_cast<const char*>(data), size);
+		}
+		Movie movie;
+		return movie.Load(corruptPath) == MovieResult::InvalidFormat;
+	};
+
+	bool allRejected = original.size() > COUNT_OFFSETS.back() + sizeof(u32);
+	for (usize size = 0; size < original.size() && allRejected; size++)
+	{
+		allRejected = rejected(original.data(), size);
+	}
+	for (const usize offset : COUNT_OFFSETS)
+	{
+		std::vector<u8> huge = original;
+		std::fill_n(huge.begin() + offset, sizeof(u32), 0xFF);
+		allRejected = allRejected && rejected(huge.data(), huge.size());
+	}
+
+	std::error_code error;
+	std::filesystem::remove(corruptPath, error);
+	return allRejected;
+}
+
+// Records a movie from power-on with a reset halfway, round trips it
+// through a file, then plays it back with and without the per-frame state
+// hash check. The checked playback has to stay in sync.
+static void BenchMovie(const std::filesystem::path& rom, Bench::JsonWriter& json)
+{
+	auto recorder = std::make_unique<NES>();
+	if (!recorder->LoadROM(rom))
+		return;
+	recorder->Reset();
+
+	Movie recorded;
+	recorded.Begin(*recorder->GetCartridge().GetImage());
+	for (u64 frame = 0; frame < MOVIE_FRAMES; frame++)
+	{
+		const bool reset = frame == MOVIE_FRAMES / 2;
+		if (reset)
+		{
+			recorder->Reset();
+		}
+		const u8 buttons = PoolAction(frame, 0);
+		recorder->SetButtonsState(buttons);
+		recorder->StepFrame();
+		recorded.AddFrame(buttons, reset, recorder->GetStateHash());
+	}
+
+	const std::filesystem::path moviePath = std::filesystem::temp_directory_path() / "nes-bench.nesmovie";
+	Movie movie;
+	if (recorded.Save(moviePath) != MovieResult::Success || movie.Load(moviePath) != MovieResult::Success)
+	{
+		LOG_ERROR("Failed to round trip movie through %s", moviePath.string().c_str());
+		return;
+	}
+	std::error_code error;
+	const u64 fileBytes = std::filesystem::file_size(moviePath, error);
+	const bool corruptRejected = CheckCorruptMovies(moviePath);
+	std::filesystem::remove(moviePath, error);
+	if (!corruptRejected)
+	{
+		LOG_ERROR("A corrupt copy of the movie for %s loaded", rom.filename().string().c_str());
+	}
+
+	auto play = [&](bool checkHashes, bool& match)
+	{
+		auto nes = std::make_unique<NES>();
+		if (!nes->LoadROM(recorder->GetCartridge().GetImage()))
+			return 0.0;
+		nes->Reset();
+
+		match = movie.MatchesRom(*nes->GetCartridge().GetImage()) &&
+				movie.GetFrameCount() == MOVIE_FRAMES;
+		const auto begin = Bench::Clock::now();
+		for (usize frame = 0; frame < movie.GetFrameCount() && match; frame++)
+		{
+			movie.ApplyFrame(*nes, frame);
+			nes->StepFrame();
+			if (checkHashes)
+			{
+				match = nes->GetStateHash() == movie.GetStateHash(frame);
+			}
+		}
+		const double seconds = Bench::SecondsSince(begin);
+		return seconds > 0.0 ? MOVIE_FRAMES / seconds : 0.0;
+	};
+
+	bool match = false;
+	const double plainFps = play(false, match);
+	const double checkedFps = play(true, match);
+
+	if (!match)
+	{
+		LOG_ERROR("Movie playback desynced on %s", rom.filename().string().c_str());
+	}
+
+	json.BeginObject("movie");
+	json.Field("frames", MOVIE_FRAMES);
+	json.Field("file_bytes", fileBytes);
+	json.Field("playback_fps", plainFps);
+	json.Field("checked_playback_fps", checkedFps);
+	json.Field("match", match);
+	json.Field("corrupt_rejected", corruptRejected);
+	json.EndObject();
+}
+
+static void BenchRom(const std::filesystem::path& path, const BenchOptions& options,
+					 const Bench::TickCalibration& calibration,
+					 Bench::JsonWriter& json, std::vector<u16>& lastFrame)
+{
+	json.BeginObject();
+	json.Field("rom", path.filename().string());
+
+	auto nes = std::make_unique<NES>();
+	if (!nes->LoadROM(path))
+	{
+		json.Field("error", std::string_view{ "failed to load" });
+		json.EndObject();
+		return;
+	}
+	nes->Reset();
+	json.Field("mapper", static_cast<u64>(nes->GetCartridge().GetMapperNumber()));
+
+	BenchRomLoad(path, json);
+	BenchMovie(path, json);
+
+	for (u64 frame = 0; frame < options.warmupFrames; frame++)
+	{
+		nes->StepFrame();
+	}
+
+	BenchThroughput(*nes, options, json);
+	BenchSubsystems(*nes, options, calibration, json);
+	BenchBusRead(*nes, json);
+	BenchSaveState(*nes, json);
+	BenchStateHash(*nes, json);
+	BenchRewind(*nes, "rewind", RewindConfig{}, json);
+	BenchRewind(*nes, "rewind_small_budget", SMALL_REWIND_CONFIG, json);
+	BenchRunAhead(*nes, json);
+	BenchFrameSkip(*nes, json);
+	BenchAudio(*nes, json);
+	BenchFork(*nes, json);
+
+	const u16* framebuffer = nes->GetFramebuffer();
+	lastFrame.assign(framebuffer, framebuffer + PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT);
+
+	json.EndObject();
+}
+
+// Runs the pool on one ROM at 1, 2, 4, ... threads up to the hardware
+// thread count. Each run starts from reset with the same inputs, and its
+// final frames have to match the single-threaded run's. Instance 0 is
+// also checked against a lone NES.
+static void BenchPool(const std::filesystem::path& rom, Bench::JsonWriter& json)
+{
+	std::vector<u32> threadCounts{ 1 };
+	const u32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (u32 threads = 2; threads < hardwareThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(std::max(2u, hardwareThreads));
+
+	std::vector<u16> framebuffers(POOL_INSTANCES * NESPool::FRAME_PIXELS);
+	std::vector<u8> actions(POOL_INSTANCES);
+	std::vector<u64> reference(POOL_INSTANCES);
+
+	NES lone{};
+	if (!lone.LoadROM(rom))
+		return;
+	lone.Reset();
+	for (u64 frame = 0; frame < POOL_FRAMES; frame++)
+	{
+		lone.SetButtonsState(PoolAction(frame, 0));
+		lone.StepFrame();
+	}
+	const u64 loneHash = HashFramebuffer(lone.GetFramebuffer());
+
+	json.BeginObject("pool");
+	json.Field("rom", rom.filename().string());
+	json.Field("instances", static_cast<u64>(POOL_INSTANCES));
+	json.Field("frames", POOL_FRAMES);
+	json.Field("hardware_threads", static_cast<u64>(hardwareThreads));
+	json.BeginArray("runs");
+
+	double baseFps = 0.0;
+	for (u32 threads : threadCounts)
+	{
+		NESPool pool{ POOL_INSTANCES, threads };
+		if (!pool.LoadROM(rom))
+			break;
+		pool.Reset();
+
+		const auto begin = Bench::Clock::now();
+		for (u64 frame = 0; frame < POOL_FRAMES; frame++)
+		{
+			for (usize i = 0; i < POOL_INSTANCES; i++)
+			{
+				actions[i] = PoolAction(frame, i);
+			}
+			pool.Step(actions, framebuffers.data());
+		}
+		const double fps = POOL_INSTANCES * POOL_FRAMES / Bench::SecondsSince(begin);
+
+		bool match = HashFramebuffer(framebuffers.data()) == loneHash;
+		for (usize i = 0; i < POOL_INSTANCES; i++)
+		{
+			const u64 hash = HashFramebuffer(framebuffers.data() + i * NESPool::FRAME_PIXELS);
+			if (threads == 1)
+			{
+				reference[i] = hash;
+			}
+			match = match && hash == reference[i];
+		}
+		if (threads == 1)
+		{
+			baseFps = fps;
+		}
+
+		if (!match)
+		{
+			LOG_ERROR("NES pool frames differ at %u threads", threads);
+		}
+
+		json.BeginObject();
+		json.Field("threads", static_cast<u64>(threads));
+		json.Field("fps", fps);
+		json.Field("speedup", baseFps > 0.0 ? fps / baseFps : 0.0);
+		json.Field("efficiency", baseFps > 0.0 ? fps / baseFps / threads : 0.0);
+		json.Field("match", match);
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.EndObject();
+}
+
+static u64 ChecksumPixels(const std::vector<WindowPixel>& pixels)
+{
+	u64 checksum = 0;
+	for (const WindowPixel& pixel : pixels)
+	{
+		checksum += pixel.r + pixel.g + pixel.b;
+	}
+	return checksum;
+}
+
+struct ConversionResult
+{
+	double kernelNs = 0.0;
+	double scalarNs = 0.0;
+	bool match = false;
+	u64 checksum = 0;
+};
+
+static ConversionResult TimeConversion(const std::vector<u16>& frame, const FrameConversion::Lut& lut)
+{
+	constexpr usize PIXELS = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT;
+	std::vector<WindowPixel> scalarDst(PIXELS);
+	std::vector<WindowPixel> kernelDst(PIXELS);
+
+	ConversionResult result{};
+	auto begin = Bench::Clock::now();
+	for (u32 i = 0; i < CONVERSION_ITERATIONS; i++)
+	{
+		FrameConversion::ConvertScalar(frame.data(), scalarDst.data(), PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT, lut, true);
+	}
+	result.scalarNs = Bench::SecondsSince(begin) * 1e9 / CONVERSION_ITERATIONS;
+
+	begin = Bench::Clock::now();
+	for (u32 i = 0; i < CONVERSION_ITERATIONS; i++)
+	{
+		FrameConversion::Convert(frame.data(), kernelDst.data(), PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT, lut, true);
+	}
+	result.kernelNs = Bench::SecondsSince(begin) * 1e9 / CONVERSION_ITERATIONS;
+
+	result.match = std::memcmp(scalarDst.data(), kernelDst.data(), PIXELS * sizeof(WindowPixel)) == 0;
+	result.checksum = ChecksumPixels(kernelDst);
+	return result;
+}
+
+// Framebuffer to window pixel conversion as the window thread does it
+// through FrameConversion::Convert, with the vertical flip, for the
+// dispatched kernel and the scalar one. The kernel is always checked
+// against the scalar one on noise across every emphasis setting, since
+// games rarely set the emphasis bits; the last emulated frame, when there
+// is one, is timed as well.
+static void BenchFrameConversion(const std::vector<u16>& emulatedFrame, Bench::JsonWriter& json)
+{
+	constexpr usize PIXELS = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT;
+
+	std::vector<u16> noiseFrame(PIXELS);
+	u32 seed = 0x12345678;
+	for (u16& pixel : noiseFrame)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		pixel = (seed >> 16) & (EMPHASIS_PALETTE_LENGTH - 1);
+	}
+
+	FrameConversion::SystemPalette palette{};
+	for (usize i = 0; i < palette.size(); i++)
+	{
+		palette[i] = { static_cast<u8>(i * 3), static_cast<u8>(i * 5), static_cast<u8>(i * 7), 0 };
+	}
+	FrameConversion::Lut lut{};
+	FrameConversion::BuildLut(palette, lut);
+
+	auto writeResult = [&](const char* name, const ConversionResult& result)
+	{
+		if (!result.match)
+		{
+			LOG_ERROR("%s frame conversion doesn't match the scalar one on the %s frame",
+					  FrameConversion::GetKernelName(), name);
+		}
+		json.BeginObject(name);
+		json.Field("ns_per_frame", result.kernelNs);
+		json.Field("ns_per_pixel", result.kernelNs / PIXELS);
+		json.Field("scalar_ns_per_frame", result.scalarNs);
+		json.Field("match", result.match);
+		json.Field("checksum", result.checksum);
+		json.EndObject();
+	};
+
+	json.BeginObject("frame_conversion");
+	json.Field("kernel", std::string_view{ FrameConversion::GetKernelName() });
+	writeResult("noise", TimeConversion(noiseFrame, lut));
+	if (emulatedFrame.size() == PIXELS)
+	{
+		writeResult("emulated", TimeConversion(emulatedFrame, lut));
+	}
+	json.EndObject();
+}
+
+// Frame handoff between the emulation and window threads as Emulator
+// does it, with the consumer always trying to keep up. Every frame is
+// filled with its sequence number, so a torn or out of order frame
+// shows up, and every published frame has to be either acquired or
+// reported dropped.
+static void BenchTripleBuffer(Bench::JsonWriter& json)
+{
+	using Frame = Array<u16, PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT>;
+
+	auto frames = std::make_unique<TripleBuffer<Frame>>();
+	std::atomic<bool> done{ false };
+	u64 dropped = 0;
+	double publishSeconds = 0.0;
+
+	const auto begin = Bench::Clock::now();
+	std::thread producer{ [&] {
+		for (u32 sequence = 1; sequence <= TRIPLE_BUFFER_FRAMES; sequence++)
+		{
+			frames->GetWriteBuffer().fill(static_cast<u16>(sequence));
+			const auto publishBegin = Bench::Clock::now();
+			if (!frames->Publish())
+			{
+				dropped++;
+			}
+			publishSeconds += Bench::SecondsSince(publishBegin);
+		}
+		done.store(true, std::memory_order_release);
+	} };
+
+	u64 acquired = 0;
+	u16 lastSequence = 0;
+	bool valid = true;
+	auto check = [&] {
+		const Frame& frame = frames->GetReadBuffer();
+		const u16 sequence = frame.front();
+		valid = valid && sequence > lastSequence
+				&& std::all_of(frame.begin(), frame.end(), [=](u16 pixel) { return pixel == sequence; });
+		lastSequence = sequence;
+		acquired++;
+	};
+	while (!done.load(std::memory_order_acquire))
+	{
+		if (frames->Acquire())
+		{
+			check();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	producer.join();
+	if (frames->Acquire())
+	{
+		check();
+	}
+	const double seconds = Bench::SecondsSince(begin);
+
+	valid = valid && lastSequence == static_cast<u16>(TRIPLE_BUFFER_FRAMES) && acquired + dropped == TRIPLE_BUFFER_FRAMES;
+	if (!valid)
+	{
+		LOG_ERROR("Triple buffer handed over a torn, stale or lost frame, last was %u", lastSequence);
+	}
+
+	json.BeginObject("triple_buffer");
+	json.Field("frames", static_cast<u64>(TRIPLE_BUFFER_FRAMES));
+	json.Field("acquired", acquired);
+	json.Field("dropped", dropped);
+	json.Field("ns_per_publish", publishSeconds * 1e9 / TRIPLE_BUFFER_FRAMES);
+	json.Field("frames_per_second", TRIPLE_BUFFER_FRAMES / seconds);
+	json.Field("valid", valid);
+	json.EndObject();
+}
+
+// Sample handoff from the emulation thread to the audio thread as Emulator
+// does it, both sides going as fast as they can with chunks of varying
+// size. Samples are a running count, so a lost, repeated or reordered one
+// shows up.
+static void BenchAudioRing(Bench::JsonWriter& json)
+{
+	auto ring = std::make_unique<SpscRing<i16>>(AUDIO_RING_CAPACITY);
+
+	const auto begin = Bench::Clock::now();
+	std::thread producer{ [&] {
+		Array<i16, 1024> chunk{};
+		u64 next = 0;
+		while (next < AUDIO_RING_SAMPLES)
+		{
+			const usize size = std::min<u64>(1 + next % chunk.size(), AUDIO_RING_SAMPLES - next);
+			for (usize i = 0; i < size; i++)
+			{
+				chunk[i] = static_cast<i16>(next + i);
+			}
+			usize written = 0;
+			while (written < size)
+			{
+				const usize count = ring->Write(std::span<const i16>(chunk.data() + written, size - written));
+				if (count == 0)
+				{
+					std::this_thread::yield();
+				}
+				written += count;
+			}
+			next += size;
+		}
+	} };
+
+	Array<i16, 512> out{};
+	u64 received = 0;
+	bool valid = true;
+	while (received < AUDIO_RING_SAMPLES)
+	{
+		const usize count = ring->Read(std::span<i16>(out.data(), 1 + received % out.size()));
+		if (count == 0)
+		{
+			std::this_thread::yield();
+		}
+		for (usize i = 0; i < count; i++)
+		{
+			valid = valid && out[i] == static_cast<i16>(received + i);
+		}
+		received += count;
+	}
+	producer.join();
+	const double seconds = Bench::SecondsSince(begin);
+
+	if (!valid)
+	{
+		LOG_ERROR("Audio ring lost or reordered samples (%llu samples)",
+				  static_cast<unsigned long long>(AUDIO_RING_SAMPLES));
+	}
+
+	json.BeginObject("audio_ring");
+	json.Field("samples", AUDIO_RING_SAMPLES);
+	json.Field("capacity", static_cast<u64>(ring->GetCapacity()));
+	json.Field("ns_per_sample", seconds * 1e9 / AUDIO_RING_SAMPLES);
+	json.Field("valid", valid);
+	json.EndObject();
+}
+
+// Emulator's audio path in simulated time: every frame the APU makes
+// the sample rate times the rate control's ratio in samples, and a
+// device whose clock is off by the drift plays its share of them. With
+// the ring at AUDIO_RING_CAPACITY, the fill has to settle without the
+// device ever running dry or samples being dropped once it has had time
+// to fill from empty.
+static void BenchAudioRateControl(Bench::JsonWriter& json)
+{
+	constexpr u64 SETTLE_FRAMES = 60 * 30;
+
+	json.BeginArray("audio_rate_control");
+	for (const double drift : RATE_CONTROL_DRIFTS)
+	{
+		SpscRing<i16> ring{ AUDIO_RING_CAPACITY };
+		AudioRateControl control;
+		std::vector<i16> samples(AUDIO_SAMPLE_RATE / 10);
+
+		double made = 0.0;
+		double played = 0.0;
+		u64 underruns = 0;
+		u64 dropped = 0;
+		usize minFill = ring.GetCapacity();
+		usize maxFill = 0;
+		for (u64 frame = 0; frame < RATE_CONTROL_FRAMES; frame++)
+		{
+			// Same rounding as BlipBuffer, whole samples with the fraction
+			// carried into the next frame
+			const double before = made;
+			made += AUDIO_SAMPLE_RATE * control.GetRatio() * NES::FRAME_TIME;
+			const usize count = static_cast<usize>(made) - static_cast<usize>(before);
+			const usize written = ring.Write(std::span<const i16>(samples.data(), count));
+
+			const double playedBefore = played;
+			played += AUDIO_SAMPLE_RATE * (1.0 + drift) * NES::FRAME_TIME;
+			const usize wanted = static_cast<usize>(played) - static_cast<usize>(playedBefore);
+			const usize read = ring.Read(std::span<i16>(samples.data(), wanted));
+
+			const usize fill = ring.GetSize();
+			control.Update(fill, ring.GetCapacity());
+			if (frame < SETTLE_FRAMES)
+			{
+				continue;
+			}
+			dropped += count - written;
+			underruns += read < wanted ? 1 : 0;
+			minFill = std::min(minFill, fill);
+			maxFill = std::max(maxFill, fill);
+		}
+
+		if (underruns || dropped)
+		{
+			LOG_ERROR("Audio rate control didn't hold the ring with %+.3f%% drift", drift * 100.0);
+		}
+
+		json.BeginObject();
+		json.Field("drift", drift);
+		json.Field("frames", RATE_CONTROL_FRAMES);
+		json.Field("ratio", control.GetRatio());
+		json.Field("min_fill", static_cast<u64>(minFill));
+		json.Field("max_fill", static_cast<u64>(maxFill));
+		json.Field("underruns", underruns);
+		json.Field("dropped_samples", dropped);
+		json.EndObject();
+	}
+	json.EndArray();
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options{};
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	g_Logger.Init();
+	g_Logger.SetOut(stderr);
+	g_Logger.SetLogLevel(LogLevel::Warn);
+
+	if (options.roms.empty())
+	{
+		LOG_WARN("No ROMs given and none found in %s/, only running kernel benchmarks", DEFAULT_ROM_DIR);
+	}
+
+	const Bench::TickCalibration calibration{};
+	Bench::JsonWriter json{ stdout };
+	std::vector<u16> lastFrame;
+
+	json.BeginObject();
+	json.Field("frames", options.frames);
+	json.Field("warmup_frames", options.warmupFrames);
+
+	json.BeginArray("roms");
+	for (const auto& rom : options.roms)
+	{
+		BenchRom(rom, options, calibration, json, lastFrame);
+	}
+	json.EndArray();
+
+	if (!options.roms.empty())
+	{
+		BenchPool(options.roms.front(), json);
+	}
+
+	BenchFrameConversion(lastFrame, json);
+	BenchTripleBuffer(json);
+	BenchAudioRing(json);
+	BenchAudioRateControl(json);
+
+	json.EndObject();
+	json.Finish();
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include "AudioOutput.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+AudioOutput::~AudioOutput()
+{
+    Shutdown();
+}
+
+bool AudioOutput::Init(u32 sampleRate, SpscRing<i16>* ring)
+{
+    m_Ring = ring;
+
+    WAVEFORMATEX format{};
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 1;
+    format.nSamplesPerSec = sampleRate;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+    // Auto-reset, the thread looks at every buffer each time it wakes
+    m_BufferDone = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!m_BufferDone)
+    {
+        LOG_ERROR("Failed to create audio event, error %lu", GetLastError());
+        return false;
+    }
+
+    const MMRESULT result = waveOutOpen(&m_Device, WAVE_MAPPER, &format, reinterpret_cast<DWORD_PTR>(m_BufferDone),
+                                        0, CALLBACK_EVENT);
+    if (result != MMSYSERR_NOERROR)
+    {
+        LOG_ERROR("Failed to open audio device, error %u", result);
+        m_Device = nullptr;
+        CloseHandle(m_BufferDone);
+        m_BufferDone = nullptr;
+        return false;
+    }
+
+    for (u32 i = 0; i < BUFFER_COUNT; i++)
+    {
+        WAVEHDR& header = m_Headers[i];
+        header = {};
+        header.lpData = reinterpret_cast<LPSTR>(m_Buffers[i].data());
+        header.dwBufferLength = static_cast<DWORD>(sizeof(m_Buffers[i]));
+        const MMRESULT prepared = waveOutPrepareHeader(m_Device, &header, sizeof(header));
+        if (prepared != MMSYSERR_NOERROR)
+        {
+            LOG_ERROR("Failed to prepare audio buffer, error %u", prepared);
+            CloseDevice(i);
+            return false;
+        }
+    }
+
+    m_Running.store(true, std::memory_order_relaxed);
+    m_Thread = std::thread([this] { ThreadLoop(); });
+    LOG_INFO("Opened audio device at %u Hz, %u buffers of %u samples", sampleRate, BUFFER_COUNT, BUFFER_SAMPLES);
+    return true;
+}
+
+void AudioOutput::Shutdown()
+{
+    if (!m_Device)
+    {
+        return;
+    }
+
+    m_Running.store(false, std::memory_order_relaxed);
+    SetEvent(m_BufferDone);
+    m_Thread.join();
+
+    // Hands every queued buffer back so they can be unprepared
+    waveOutReset(m_Device);
+    CloseDevice(BUFFER_COUNT);
+}
+
+void AudioOutput::CloseDevice(u32 preparedBuffers)
+{
+    for (u32 i = 0; i < preparedBuffers; i++)
+    {
+        waveOutUnprepareHeader(m_Device, &m_Headers[i], sizeof(WAVEHDR));
+    }
+    waveOutClose(m_Device);
+    m_Device = nullptr;
+
+    CloseHandle(m_BufferDone);
+    m_BufferDone = nullptr;
+}
+
+void AudioOutput::ThreadLoop()
+{
+    // The emulation and window threads only ever fill the ring, so running
+    // above them can't hold either up
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    // Every buffer starts queued, from whatever the ring holds so far
+    for (u32 i = 0; i < BUFFER_COUNT; i++)
+    {
+        Submit(i);
+    }
+
+    while (m_Running.load(std::memory_order_relaxed))
+    {
+        WaitForSingleObject(m_BufferDone, INFINITE);
+        for (u32 i = 0; i < BUFFER_COUNT && m_Running.load(std::memory_order_relaxed); i++)
+        {
+            // Set by the driver from its own thread, read as such
+            if (std::atomic_ref<DWORD>(m_Headers[i].dwFlags).load(std::memory_order_acquire) & WHDR_DONE)
+            {
+                Submit(i);
+            }
+        }
+    }
+}
+
+void AudioOutput::Submit(u32 buffer)
+{
+    Array<i16, BUFFER_SAMPLES>& samples = m_Buffers[buffer];
+    const usize count = m_Ring->Read(samples);
+    if (count < samples.size())
+    {
+        std::fill(samples.begin() + count, samples.end(), 0);
+        m_Underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    waveOutWrite(m_Device, &m_Headers[buffer], sizeof(WAVEHDR));
+}
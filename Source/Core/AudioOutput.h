@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Common.h"
+#include "SpscRing.h"
+#include "WindowsCommon.h"
+
+#include <mmsystem.h>
+
+#include <atomic>
+#include <thread>
+
+// Plays mono 16-bit samples from a ring buffer on the default device
+// through waveOut. A thread of its own, at time-critical priority, hands
+// BUFFER_COUNT small buffers to the device in turn and refills each one
+// from the ring as soon as it comes back. It never waits for whoever
+// fills the ring: if the ring runs short, the rest of the buffer is
+// silence and counts as an underrun.
+class AudioOutput
+{
+  public:
+    static constexpr u32 BUFFER_COUNT = 4;
+    // About 10.7 ms at 48 kHz
+    static constexpr u32 BUFFER_SAMPLES = 512;
+
+    ~AudioOutput();
+
+    // ring has to outlive the output, or Shutdown
+    [[nodiscard]] bool Init(u32 sampleRate, SpscRing<i16>* ring);
+
+    void Shutdown();
+
+    // Buffers that ran out of samples before they were full
+    u64 GetUnderrunCount() const
+    {
+        return m_Underruns.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void ThreadLoop();
+
+    // Refills buffer from the ring and queues it on the device
+    void Submit(u32 buffer);
+
+    // Unprepares the first preparedBuffers headers, then closes the device
+    // and the event
+    void CloseDevice(u32 preparedBuffers);
+
+  private:
+    SpscRing<i16>* m_Ring = nullptr;
+
+    HWAVEOUT m_Device = nullptr;
+    // Signalled by the device whenever it finishes a buffer
+    HANDLE m_BufferDone = nullptr;
+    Array<WAVEHDR, BUFFER_COUNT> m_Headers{};
+    Array<Array<i16, BUFFER_SAMPLES>, BUFFER_COUNT> m_Buffers{};
+
+    std::thread m_Thread{};
+    std::atomic<bool> m_Running{false};
+    std::atomic<u64> m_Underruns{0};
+};
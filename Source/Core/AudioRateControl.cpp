@@ -0,0 +1,32 @@
+#include "AudioRateControl.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+AudioRateControl::AudioRateControl(double maxDeviation) : m_MaxDeviation(maxDeviation)
+{
+}
+
+double AudioRateControl::Update(usize fill, usize capacity)
+{
+    const double level = capacity ? std::min(1.0, static_cast<double>(fill) / capacity) : 0.5;
+    m_Ratio = 1.0 + m_MaxDeviation * (1.0 - 2.0 * level);
+
+    m_UpdateCount++;
+    m_RatioSum += m_Ratio;
+    m_MinRatio = std::min(m_MinRatio, m_Ratio);
+    m_MaxRatio = std::max(m_MaxRatio, m_Ratio);
+    m_FillSum += level;
+    return m_Ratio;
+}
+
+void AudioRateControl::LogStats() const
+{
+    if (m_UpdateCount == 0)
+    {
+        return;
+    }
+    LOG_INFO("Audio rate control: %llu updates, ratio mean %.5f, min %.5f, max %.5f, mean fill %.1f%%",
+             static_cast<unsigned long long>(m_UpdateCount), m_RatioSum / m_UpdateCount, m_MinRatio, m_MaxRatio,
+             100.0 * m_FillSum / m_UpdateCount);
+}
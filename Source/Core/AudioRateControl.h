@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Common.h"
+
+// Dynamic rate control for sound made by an emulator that is paced by the
+// video clock and played by a device running on a clock of its own. The
+// two never agree exactly, so at a fixed rate the buffer between them
+// slowly fills up until samples are dropped, or drains until the device
+// plays gaps. Instead, after every frame the emulator's sample rate is
+// scaled by a ratio that grows as the buffer drains and shrinks as it
+// fills, 1 at half full, which holds the buffer near a steady level. The
+// clocks differ by well under a percent, so the pitch change is inaudible.
+class AudioRateControl
+{
+  public:
+    // Largest change to the sample rate, either way
+    static constexpr double DEFAULT_MAX_DEVIATION = 0.005;
+
+    explicit AudioRateControl(double maxDeviation = DEFAULT_MAX_DEVIATION);
+
+    // Ratio for the next frame given how full the buffer is now
+    double Update(usize fill, usize capacity);
+
+    double GetRatio() const
+    {
+        return m_Ratio;
+    }
+
+    // Mean, lowest and highest ratio and the mean fill since construction
+    void LogStats() const;
+
+  private:
+    double m_MaxDeviation = DEFAULT_MAX_DEVIATION;
+    double m_Ratio = 1.0;
+
+    u64 m_UpdateCount = 0;
+    double m_RatioSum = 0.0;
+    double m_MinRatio = 1.0;
+    double m_MaxRatio = 1.0;
+    double m_FillSum = 0.0;
+};
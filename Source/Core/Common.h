@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -67,3 +68,6 @@ template <typename T, size_t N> using Array = std::array<T, N>;
 template <typename T, size_t M, size_t N> using Array2D = std::array<std::array<T, M>, N>;
 
 template <size_t N> using Memory = Array<u8, N>;
+
+// Used to keep data written by different threads on separate lines
+inline constexpr usize CACHE_LINE_SIZE = 64;
@@ -0,0 +1,233 @@
+#include "Compression.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// Block format, a sequence of:
+//   token       high nibble literal count, low nibble match length - 4,
+//               15 in either means more length bytes follow
+//   lengths     255 255 ... n for the literal count
+//   literals
+//   offset      2 bytes little endian, distance back to the match
+//   lengths     same scheme for the match length
+// The last sequence stops after its literals.
+
+static constexpr usize MIN_MATCH = 4;
+static constexpr usize MAX_OFFSET = 0xFFFF;
+static constexpr u32 HASH_BITS = 12;
+static constexpr u8 NIBBLE_MAX = 15;
+
+static u32 Read32(const u8* p)
+{
+    u32 val;
+    std::memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static u32 Hash(u32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static u64 Read64(const u8* p)
+{
+    u64 val;
+    std::memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+// Length of the common prefix of a and b, at most limit. Compares 8 bytes
+// at a time, the first differing byte found from the XOR (little endian).
+static usize MatchLength(const u8* a, const u8* b, usize limit)
+{
+    usize length = 0;
+    while (length + sizeof(u64) <= limit)
+    {
+        const u64 diff = Read64(a + length) ^ Read64(b + length);
+        if (diff)
+        {
+            return length + (std::countr_zero(diff) >> 3);
+        }
+        length += sizeof(u64);
+    }
+    while (length < limit && a[length] == b[length])
+    {
+        length++;
+    }
+    return length;
+}
+
+// Writes the bytes following a nibble of 15. Returns false when out of
+// space.
+static bool WriteLength(usize length, u8*& out, const u8* end)
+{
+    while (length >= 255)
+    {
+        if (out == end)
+            return false;
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out == end)
+        return false;
+    *out++ = static_cast<u8>(length);
+    return true;
+}
+
+static bool ReadLength(usize& length, const u8*& in, const u8* end)
+{
+    u8 byte;
+    do
+    {
+        if (in == end)
+            return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static bool WriteSequence(const u8* literals, usize literalCount, usize offset, usize matchLength, u8*& out,
+                          const u8* end)
+{
+    if (out == end)
+        return false;
+    u8* token = out++;
+
+    const usize matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+    *token = static_cast<u8>((std::min<usize>(literalCount, NIBBLE_MAX) << 4) | std::min<usize>(matchCode, NIBBLE_MAX));
+
+    if (literalCount >= NIBBLE_MAX && !WriteLength(literalCount - NIBBLE_MAX, out, end))
+        return false;
+    if (static_cast<usize>(end - out) < literalCount)
+        return false;
+    std::memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    if (!matchLength)
+        return true;
+
+    if (end - out < 2)
+        return false;
+    *out++ = static_cast<u8>(offset);
+    *out++ = static_cast<u8>(offset >> 8);
+    if (matchCode >= NIBBLE_MAX && !WriteLength(matchCode - NIBBLE_MAX, out, end))
+        return false;
+    return true;
+}
+
+namespace Compression
+{
+    usize GetCompressBound(usize size)
+    {
+        return size + size / 255 + 16;
+    }
+
+    usize Compress(const u8* src, usize size, u8* dst, usize capacity)
+    {
+        Array<u32, 1 << HASH_BITS> table{};
+
+        u8* out = dst;
+        const u8* end = dst + capacity;
+
+        usize anchor = 0;
+        usize pos = 0;
+        while (pos + MIN_MATCH <= size)
+        {
+            const u32 sequence = Read32(src + pos);
+            u32& slot = table[Hash(sequence)];
+            const usize candidate = slot;
+            slot = static_cast<u32>(pos);
+
+            if (candidate >= pos || pos - candidate > MAX_OFFSET || Read32(src + candidate) != sequence)
+            {
+                // Step faster through data that isn't matching
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            const usize matchLength = MIN_MATCH + MatchLength(src + candidate + MIN_MATCH, src + pos + MIN_MATCH,
+                                                              size - pos - MIN_MATCH);
+
+            if (!WriteSequence(src + anchor, pos - anchor, pos - candidate, matchLength, out, end))
+                return 0;
+
+            pos += matchLength;
+            anchor = pos;
+
+            // Remember a position inside the match too, so the next run of
+            // the same bytes finds a close, long match
+            if (pos + MIN_MATCH <= size)
+            {
+                table[Hash(Read32(src + pos - 2))] = static_cast<u32>(pos - 2);
+            }
+        }
+
+        if (!WriteSequence(src + anchor, size - anchor, 0, 0, out, end))
+            return 0;
+        return out - dst;
+    }
+
+    bool Decompress(const u8* src, usize size, u8* dst, usize dstSize)
+    {
+        const u8* in = src;
+        const u8* inEnd = src + size;
+        u8* out = dst;
+        const u8* outEnd = dst + dstSize;
+
+        while (in < inEnd)
+        {
+            const u8 token = *in++;
+
+            usize literalCount = token >> 4;
+            if (literalCount == NIBBLE_MAX && !ReadLength(literalCount, in, inEnd))
+                return false;
+            if (static_cast<usize>(inEnd - in) < literalCount || static_cast<usize>(outEnd - out) < literalCount)
+                return false;
+            std::memcpy(out, in, literalCount);
+            in += literalCount;
+            out += literalCount;
+
+            if (in == inEnd)
+                break;
+
+            if (inEnd - in < 2)
+                return false;
+            const usize offset = in[0] | (in[1] << 8);
+            in += 2;
+
+            usize matchLength = token & NIBBLE_MAX;
+            if (matchLength == NIBBLE_MAX && !ReadLength(matchLength, in, inEnd))
+                return false;
+            matchLength += MIN_MATCH;
+
+            if (offset == 0 || offset > static_cast<usize>(out - dst) ||
+                static_cast<usize>(outEnd - out) < matchLength)
+                return false;
+
+            const u8* match = out - offset;
+            if (offset >= matchLength)
+            {
+                std::memcpy(out, match, matchLength);
+            }
+            else
+            {
+                // The match repeats its first offset bytes. Once those are
+                // out, keep doubling what has been written; every step
+                // starts on a multiple of offset so it copies the pattern.
+                std::memcpy(out, match, offset);
+                usize copied = offset;
+                while (copied < matchLength)
+                {
+                    const usize step = std::min(copied, matchLength - copied);
+                    std::memcpy(out + copied, out, step);
+                    copied += step;
+                }
+            }
+            out += matchLength;
+        }
+
+        return out == outEnd;
+    }
+}
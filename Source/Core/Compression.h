@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Common.h"
+
+// Byte-oriented LZ77 in the style of LZ4 blocks: no entropy coding, one
+// hash probe per position, and a decoder that is little more than
+// memcpy. Meant for save state deltas, which are mostly zero runs.
+namespace Compression
+{
+    // Largest output Compress can produce for size input bytes
+    usize GetCompressBound(usize size);
+
+    // Returns the compressed size, or 0 if it wouldn't fit in capacity
+    usize Compress(const u8* src, usize size, u8* dst, usize capacity);
+
+    // Fails on malformed input or when the output isn't exactly dstSize
+    [[nodiscard]] bool Decompress(const u8* src, usize size, u8* dst, usize dstSize);
+}
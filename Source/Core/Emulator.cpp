@@ -2,9 +2,51 @@
 #include "../NES/PPU.h"
 #include "Logger.h"
 
+#include <mmsystem.h>
+
 #include <fstream>
 #include <thread>
 
+static constexpr KeyCode REWIND_KEY = KeyCode::Backspace;
+static constexpr KeyCode RESET_KEY = KeyCode::F5;
+static constexpr KeyCode TIMINGS_KEY = KeyCode::F9;
+// Input from power-on is recorded here and written on exit, or when
+// rewinding first breaks the recording
+static constexpr const char* MOVIE_PATH = "recording.nesmovie";
+// Frames emulated past the real one each step to hide in-game input lag,
+// 0 turns run-ahead off
+static constexpr u32 RUN_AHEAD_FRAMES = 1;
+static constexpr u32 AUDIO_SAMPLE_RATE = 48000;
+// About 85 ms, rate control keeps it near half full
+static constexpr usize AUDIO_RING_SAMPLES = 4096;
+// Windows rounds sleeps up to the system timer tick, 15.6 ms by default,
+// which is most of a frame and far more than the pacer's spin margin
+static constexpr UINT TIMER_PERIOD_MS = 1;
+
+// Where a frame's time goes on each thread. The window thread's frames are
+// loop iterations, one per frame presented unless it falls behind.
+enum EmulationStage : u32
+{
+    EMULATION_STEP,
+    EMULATION_AUDIO,
+    EMULATION_SLEEP
+};
+static constexpr Array<const char*, 3> EMULATION_STAGE_NAMES = {"step", "audio", "sleep"};
+enum PresentStage : u32
+{
+    PRESENT_INPUT,
+    PRESENT_WAIT,
+    PRESENT_CONVERT,
+    PRESENT_PRESENT
+};
+static constexpr Array<const char*, 4> PRESENT_STAGE_NAMES = {"input", "wait", "convert", "present"};
+// About 10 seconds at 60 fps
+static constexpr usize TIMING_WINDOW_FRAMES = 600;
+// Timings the emulation thread can get ahead of the window thread by
+static constexpr usize TIMING_RING_FRAMES = 256;
+static constexpr const char* EMULATION_TIMINGS_PATH = "frame_timings_emulation.csv";
+static constexpr const char* PRESENT_TIMINGS_PATH = "frame_timings_present.csv";
+
 static void GlobalInit()
 {
     g_Logger.Init();
@@ -27,6 +69,16 @@ Emulator::Emulator()
     }
 
     m_Nes->Reset();
+    m_Frames = std::make_unique<TripleBuffer<Frame>>();
+    m_Rewind = std::make_unique<RewindBuffer>(m_Nes->GetSaveStateSize());
+    m_RunAhead = std::make_unique<RunAhead>(m_Nes->GetSaveStateSize(), RUN_AHEAD_FRAMES);
+    m_Movie.Begin(*m_Nes->GetCartridge().GetImage());
+    m_Recording = true;
+    m_AudioRing = std::make_unique<SpscRing<i16>>(AUDIO_RING_SAMPLES);
+    m_AudioSamples.resize(AUDIO_SAMPLE_RATE / 10);
+    m_EmulationTimes = std::make_unique<SpscRing<FrameTimings::Frame>>(TIMING_RING_FRAMES);
+    m_EmulationTimings = std::make_unique<FrameTimings>(EMULATION_STAGE_NAMES, TIMING_WINDOW_FRAMES);
+    m_PresentTimings = std::make_unique<FrameTimings>(PRESENT_STAGE_NAMES, TIMING_WINDOW_FRAMES);
 
     m_Window.Init(windowSpec);
     Input::PollEvents();
@@ -45,6 +97,7 @@ Emulator::Emulator()
 
 Emulator::~Emulator()
 {
+    StopRecording();
     Input::Shutdown();
 }
 
@@ -83,73 +136,226 @@ bool Emulator::LoadPalette(const std::filesystem::path& path, int num)
         m_SystemPalette[i].g = buf[i * 3 + 1];
         m_SystemPalette[i].b = buf[i * 3 + 2];
     }
+    FrameConversion::BuildLut(m_SystemPalette, m_PaletteLut);
     return true;
 }
 
-void Emulator::OnRender()
+void Emulator::ConvertFrame(const Frame& frame)
 {
-    auto windowFramebuffer = m_Window.GetFramebuffer();
-    const u8* ppuFramebuffer = m_Nes->GetFramebuffer();
-    for (usize y = 0; y < PPU::SCREEN_HEIGHT; y++)
+    // The DIB is bottom-up
+    FrameConversion::Convert(frame.data(), m_Window.GetFramebuffer().data(), PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT,
+                             m_PaletteLut, true);
+}
+
+void Emulator::DrainEmulationTimings()
+{
+    FrameTimings::Frame times{};
+    while (m_EmulationTimes->Read(std::span<FrameTimings::Frame>(&times, 1)) > 0)
     {
-        const usize srcRow = y;
-        const usize dstRow = PPU::SCREEN_HEIGHT - y - 1;
+        m_EmulationTimings->AddFrame(times);
+    }
+}
 
-        for (usize x = 0; x < PPU::SCREEN_WIDTH; x++)
-        {
-            const usize srcIndex = srcRow * PPU::SCREEN_WIDTH + x;
-            const usize dstIndex = dstRow * PPU::SCREEN_WIDTH + x;
-            const WindowPixel color = m_SystemPalette[ppuFramebuffer[srcIndex]];
-            windowFramebuffer[dstIndex] = color;
-        }
+void Emulator::ExportTimings()
+{
+    DrainEmulationTimings();
+    if (!m_EmulationTimings->ExportCsv(EMULATION_TIMINGS_PATH) || !m_PresentTimings->ExportCsv(PRESENT_TIMINGS_PATH))
+    {
+        LOG_ERROR("Failed to write frame timings to %s and %s", EMULATION_TIMINGS_PATH, PRESENT_TIMINGS_PATH);
+        return;
     }
-    m_Window.Present();
+    LOG_INFO("Wrote frame timings to %s and %s", EMULATION_TIMINGS_PATH, PRESENT_TIMINGS_PATH);
+    m_EmulationTimings->LogStats("Emulation");
+    m_PresentTimings->LogStats("Present");
 }
 
 void Emulator::UpdateInput()
 {
     Input::PollEvents();
-    m_Nes->SetButtonsState(m_Controller.ToHardwareState());
+
+    // Latched until the emulation thread takes it, so a tap shorter than
+    // a frame still resets
+    const bool resetHeld = Input::IsPressed(RESET_KEY);
+    if (resetHeld && !m_ResetHeld)
+    {
+        m_ResetRequested.store(true, std::memory_order_relaxed);
+    }
+    m_ResetHeld = resetHeld;
+
+    const bool timingsHeld = Input::IsPressed(TIMINGS_KEY);
+    m_TimingsRequested = m_TimingsRequested || (timingsHeld && !m_TimingsHeld);
+    m_TimingsHeld = timingsHeld;
+
+    m_RewindHeld.store(Input::IsPressed(REWIND_KEY), std::memory_order_relaxed);
+    m_Buttons.store(m_Controller.ToHardwareState(), std::memory_order_relaxed);
 }
 
-void Emulator::Run()
+void Emulator::StepFrame(u8 buttons, bool reset)
 {
-    using namespace std::chrono;
-    using clock = high_resolution_clock;
-    constexpr u64 frameTimeNS = static_cast<u64>(NES::FRAME_TIME * 1000000000);
+    m_Nes->SetButtonsState(buttons);
 
-    auto nextFrame = clock::now();
-    auto lastSec = nextFrame;
-    double frameTimeTotal = 0.0;
-    int frames = 0;
+    // Rewinding loads the state from the start of the previous frame and
+    // runs it again to redraw it, without recording
+    if (m_RewindHeld.load(std::memory_order_relaxed) && m_Rewind->Rewind(*m_Nes))
+    {
+        // The movie can't follow the history backwards
+        StopRecording();
+        m_Nes->StepFrame();
+        return;
+    }
 
-    while (!m_Window.ShouldQuit())
+    // Before the snapshot, so rewinding back to this frame keeps the reset
+    if (reset)
     {
-        auto frameBegin = clock::now();
+        m_Nes->Reset();
+    }
 
-        nextFrame += nanoseconds(frameTimeNS);
+    m_Rewind->Push(*m_Nes);
+    m_RunAhead->StepFrame(*m_Nes);
 
-        UpdateInput();
+    if (m_Recording)
+    {
+        m_Movie.AddFrame(buttons, reset, m_Nes->GetStateHash());
+    }
+}
 
-        m_Nes->StepFrame();
+void Emulator::PushAudio()
+{
+    usize count = 0;
+    while ((count = m_Nes->ReadAudioSamples(m_AudioSamples)) > 0)
+    {
+        m_DroppedSamples += count - m_AudioRing->Write(std::span<const i16>(m_AudioSamples.data(), count));
+    }
+    m_Nes->SetAudioRateRatio(m_AudioRate.Update(m_AudioRing->GetSize(), m_AudioRing->GetCapacity()));
+}
+
+void Emulator::StopRecording()
+{
+    if (!m_Recording)
+    {
+        return;
+    }
+    m_Recording = false;
 
-        OnRender();
+    if (m_Movie.Save(MOVIE_PATH) != MovieResult::Success)
+    {
+        LOG_ERROR("Failed to save movie to %s", MOVIE_PATH);
+        return;
+    }
+    LOG_INFO("Saved %llu frame movie to %s", static_cast<unsigned long long>(m_Movie.GetFrameCount()), MOVIE_PATH);
+}
+
+void Emulator::EmulationLoop()
+{
+    m_Nes->SetFramebuffer(m_Frames->GetWriteBuffer().data());
 
-        auto frameEnd = clock::now();
+    // Only while the paced loop runs, a finer tick costs power system-wide
+    const bool timerPeriodSet = timeBeginPeriod(TIMER_PERIOD_MS) == TIMERR_NOERROR;
+    if (!timerPeriodSet)
+    {
+        LOG_WARN("Failed to set the timer period to %u ms, frames may be paced late", TIMER_PERIOD_MS);
+    }
+    m_Pacer.Reset();
 
-        const double frameTimeReal = duration<double>(frameEnd - frameBegin).count();
-        frameTimeTotal += frameTimeReal;
-        frames++;
+    FrameTimings::Stopwatch stopwatch;
+    while (m_Running.load(std::memory_order_relaxed))
+    {
+        FrameTimings::Frame times{};
 
-        if (frameEnd > lastSec)
+        const u8 buttons = m_Buttons.load(std::memory_order_relaxed);
+        const bool reset = m_ResetRequested.exchange(false, std::memory_order_relaxed);
+        StepFrame(buttons, reset);
+
+        if (m_Nes->FrameRendered())
         {
-            lastSec += seconds(1);
+            if (!m_Frames->Publish())
+            {
+                m_DroppedFrames++;
+            }
+            m_Nes->SetFramebuffer(m_Frames->GetWriteBuffer().data());
+            m_FramesPublished.fetch_add(1, std::memory_order_release);
+            m_FramesPublished.notify_one();
+        }
+        stopwatch.Lap(times, EMULATION_STEP);
+
+        if (m_Nes->GetAudioSampleRate())
+        {
+            PushAudio();
+        }
+        stopwatch.Lap(times, EMULATION_AUDIO);
+
+        m_Pacer.WaitForNextFrame();
+        stopwatch.Lap(times, EMULATION_SLEEP);
+
+        // Lost if the window thread is that far behind, the ring never blocks
+        m_EmulationTimes->Write(std::span<const FrameTimings::Frame>(&times, 1));
+    }
+
+    if (timerPeriodSet)
+    {
+        timeEndPeriod(TIMER_PERIOD_MS);
+    }
+}
+
+void Emulator::Run()
+{
+    // Starts at the fill rate control aims for, otherwise the device's first
+    // buffers find the ring empty before the first frame is emulated
+    const std::vector<i16> silence(m_AudioRing->GetCapacity() / 2);
+    m_AudioRing->Write(silence);
+
+    // Without a device the APU still runs, it just doesn't synthesize
+    if (m_Audio.Init(AUDIO_SAMPLE_RATE, m_AudioRing.get()))
+    {
+        m_Nes->SetAudioSampleRate(AUDIO_SAMPLE_RATE);
+    }
+
+    m_Running.store(true, std::memory_order_relaxed);
+    m_EmulationThread = std::thread([this] { EmulationLoop(); });
 
-            // LOG_INFO("Frame time avg: %f, fps: %d", frameTimeTotal / frames, frames);
-            frames = 0;
-            frameTimeTotal = 0.0;
+    // Presenting never holds up emulation: a slow Present just means the
+    // frames published meanwhile are skipped in favour of the newest
+    u64 presented = 0;
+    FrameTimings::Stopwatch stopwatch;
+    while (!m_Window.ShouldQuit())
+    {
+        FrameTimings::Frame times{};
+
+        UpdateInput();
+        stopwatch.Lap(times, PRESENT_INPUT);
+
+        m_FramesPublished.wait(presented, std::memory_order_acquire);
+        presented = m_FramesPublished.load(std::memory_order_acquire);
+        stopwatch.Lap(times, PRESENT_WAIT);
+
+        if (m_Frames->Acquire())
+        {
+            ConvertFrame(m_Frames->GetReadBuffer());
+            stopwatch.Lap(times, PRESENT_CONVERT);
+            m_Window.Present();
+            stopwatch.Lap(times, PRESENT_PRESENT);
         }
 
-        std::this_thread::sleep_until(nextFrame);
+        m_PresentTimings->AddFrame(times);
+        DrainEmulationTimings();
+        if (m_TimingsRequested)
+        {
+            m_TimingsRequested = false;
+            ExportTimings();
+        }
     }
+
+    m_Running.store(false, std::memory_order_relaxed);
+    m_EmulationThread.join();
+    LOG_INFO("Stopped emulation, %llu frames dropped", static_cast<unsigned long long>(m_DroppedFrames));
+    m_Pacer.LogStats();
+    DrainEmulationTimings();
+    m_EmulationTimings->LogStats("Emulation");
+    m_PresentTimings->LogStats("Present");
+
+    m_Audio.Shutdown();
+    LOG_INFO("Stopped audio, %llu underruns, %llu samples dropped",
+             static_cast<unsigned long long>(m_Audio.GetUnderrunCount()),
+             static_cast<unsigned long long>(m_DroppedSamples));
+    m_AudioRate.LogStats();
 }
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "../NES/Movie.h"
 #include "../NES/NES.h"
+#include "../NES/RewindBuffer.h"
+#include "../NES/RunAhead.h"
+#include "AudioOutput.h"
+#include "AudioRateControl.h"
 #include "Common.h"
+#include "FramePacer.h"
+#include "FrameTimings.h"
+#include "SpscRing.h"
+#include "TripleBuffer.h"
 #include "VirtualController.h"
 #include "Window.h"
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
 enum class NESButton;
 
@@ -17,16 +29,86 @@ class Emulator
     void Run();
 
   private:
+    using Frame = Array<u16, PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT>;
+
     bool LoadPalette(const std::filesystem::path& path, int num = 0);
 
+    // Window thread. Polls the window and controller and leaves the result
+    // for the emulation thread to pick up at its next frame.
     void UpdateInput();
 
-    void OnRender();
+    // Body of m_EmulationThread: steps the NES at the console's frame rate,
+    // paced by m_Pacer, and publishes every frame it renders to m_Frames
+    void EmulationLoop();
+
+    // Steps the NES one frame, backwards through the rewind history while
+    // the rewind key is held. Going forwards the frame shown is the one
+    // RUN_AHEAD_FRAMES ahead.
+    void StepFrame(u8 buttons, bool reset);
+
+    // Emulation thread. Moves the frame's sound into m_AudioRing and sets
+    // the sample rate for the next frame from how full the ring is.
+    void PushAudio();
+
+    // Writes the movie recorded since power-on and stops recording
+    void StopRecording();
+
+    // Window thread. Converts frame into the window's framebuffer, ready
+    // to present.
+    void ConvertFrame(const Frame& frame);
+
+    // Window thread. Takes in the timings the emulation thread sent since
+    // the last call.
+    void DrainEmulationTimings();
+
+    // Window thread. Writes both threads' timings to CSV files and logs
+    // their percentiles.
+    void ExportTimings();
 
   private:
+    // Owned by the emulation thread while it runs
     std::unique_ptr<NES> m_Nes = nullptr;
+    std::unique_ptr<RewindBuffer> m_Rewind = nullptr;
+    std::unique_ptr<RunAhead> m_RunAhead = nullptr;
+    Movie m_Movie{};
+    bool m_Recording = false;
+    u64 m_DroppedFrames = 0;
+    FramePacer m_Pacer{NES::FRAME_TIME};
+
+    // The emulation thread renders straight into the write buffer, the
+    // window thread converts whichever frame is newest when it presents
+    std::unique_ptr<TripleBuffer<Frame>> m_Frames = nullptr;
+    // Bumped after every Publish, the window thread waits on it
+    std::atomic<u64> m_FramesPublished{0};
+    std::atomic<bool> m_Running{false};
+    std::thread m_EmulationThread{};
+
+    // Written by the window thread, read once per frame by the emulation thread
+    std::atomic<u8> m_Buttons{0};
+    std::atomic<bool> m_RewindHeld{false};
+    std::atomic<bool> m_ResetRequested{false};
+    bool m_ResetHeld = false;
+    bool m_TimingsHeld = false;
+    bool m_TimingsRequested = false;
+
+    // Each emulation thread frame's timings go through the ring so that
+    // the window thread owns both sets and does all the logging
+    std::unique_ptr<SpscRing<FrameTimings::Frame>> m_EmulationTimes = nullptr;
+    std::unique_ptr<FrameTimings> m_EmulationTimings = nullptr;
+    std::unique_ptr<FrameTimings> m_PresentTimings = nullptr;
+
+    // Filled by the emulation thread after every frame, drained by
+    // m_Audio's thread as the device plays
+    std::unique_ptr<SpscRing<i16>> m_AudioRing = nullptr;
+    std::vector<i16> m_AudioSamples{};
+    AudioRateControl m_AudioRate{};
+    // Samples that didn't fit in the ring
+    u64 m_DroppedSamples = 0;
+    AudioOutput m_Audio{};
+
     // TODO: change this to abstract platform layer
-    Array<WindowPixel, 64> m_SystemPalette{};
+    FrameConversion::SystemPalette m_SystemPalette{};
+    FrameConversion::Lut m_PaletteLut{};
     VirtualController m_Controller{};
 
     Window m_Window{};
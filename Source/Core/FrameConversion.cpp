@@ -0,0 +1,141 @@
+#include "FrameConversion.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define FRAME_CONVERSION_HAS_AVX2
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// How much the channels not being emphasized are dimmed, roughly what
+// the 2C02 does
+static constexpr double EMPHASIS_ATTENUATION = 0.746;
+
+static constexpr u16 EMPHASIS_RED_BIT = 1 << 0;
+static constexpr u16 EMPHASIS_GREEN_BIT = 1 << 1;
+static constexpr u16 EMPHASIS_BLUE_BIT = 1 << 2;
+
+using RowKernel = void (*)(const u16* src, WindowPixel* dst, usize count, const WindowPixel* lut);
+
+static void ConvertRowScalar(const u16* src, WindowPixel* dst, usize count, const WindowPixel* lut)
+{
+    for (usize x = 0; x < count; x++)
+    {
+        dst[x] = lut[src[x]];
+    }
+}
+
+#ifdef FRAME_CONVERSION_HAS_AVX2
+// 16 pixels per iteration: widen the indices to 32 bits and gather the
+// BGRA words straight out of the table
+TARGET_AVX2 static void ConvertRowAvx2(const u16* src, WindowPixel* dst, usize count, const WindowPixel* lut)
+{
+    static_assert(sizeof(WindowPixel) == sizeof(int));
+    const int* table = reinterpret_cast<const int*>(lut);
+
+    usize x = 0;
+    for (; x + 16 <= count; x += 16)
+    {
+        const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        const __m256i low = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(indices));
+        const __m256i high = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(indices, 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_i32gather_epi32(table, low, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x + 8), _mm256_i32gather_epi32(table, high, 4));
+    }
+    ConvertRowScalar(src + x, dst + x, count - x, lut);
+}
+
+static bool CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct KernelChoice
+{
+    RowKernel kernel;
+    const char* name;
+};
+
+static const KernelChoice& GetKernel()
+{
+    static const KernelChoice choice = []() -> KernelChoice {
+#ifdef FRAME_CONVERSION_HAS_AVX2
+        if (CpuHasAvx2())
+        {
+            return {ConvertRowAvx2, "avx2"};
+        }
+#endif
+        return {ConvertRowScalar, "scalar"};
+    }();
+    return choice;
+}
+
+static void ConvertWith(RowKernel kernel, const u16* src, WindowPixel* dst, usize width, usize height,
+                        const FrameConversion::Lut& lut, bool flipVertical)
+{
+    for (usize y = 0; y < height; y++)
+    {
+        const usize dstRow = flipVertical ? height - y - 1 : y;
+        kernel(src + y * width, dst + dstRow * width, width, lut.data());
+    }
+}
+
+namespace FrameConversion
+{
+    void BuildLut(const SystemPalette& palette, Lut& lut)
+    {
+        for (usize emphasis = 0; emphasis < lut.size() / palette.size(); emphasis++)
+        {
+            for (usize index = 0; index < palette.size(); index++)
+            {
+                WindowPixel color = palette[index];
+                // Columns $E and $F are black and unaffected
+                if ((index & 0x0F) < 0x0E)
+                {
+                    // Each emphasis bit dims the two channels it doesn't name
+                    auto attenuate = [emphasis](u8& channel, u16 bit) {
+                        for (u16 other = EMPHASIS_RED_BIT; other <= EMPHASIS_BLUE_BIT; other <<= 1)
+                        {
+                            if (other != bit && (emphasis & other))
+                            {
+                                channel = static_cast<u8>(channel * EMPHASIS_ATTENUATION);
+                            }
+                        }
+                    };
+                    attenuate(color.r, EMPHASIS_RED_BIT);
+                    attenuate(color.g, EMPHASIS_GREEN_BIT);
+                    attenuate(color.b, EMPHASIS_BLUE_BIT);
+                }
+                lut[(emphasis << PIXEL_EMPHASIS_SHIFT) | index] = color;
+            }
+        }
+    }
+
+    void Convert(const u16* src, WindowPixel* dst, usize width, usize height, const Lut& lut, bool flipVertical)
+    {
+        ConvertWith(GetKernel().kernel, src, dst, width, height, lut, flipVertical);
+    }
+
+    void ConvertScalar(const u16* src, WindowPixel* dst, usize width, usize height, const Lut& lut,
+                       bool flipVertical)
+    {
+        ConvertWith(ConvertRowScalar, src, dst, width, height, lut, flipVertical);
+    }
+
+    const char* GetKernelName()
+    {
+        return GetKernel().name;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+#include "../NES/SystemCommon.h"
+
+// Same layout as the Win32 DIB pixels the window presents
+struct WindowPixel
+{
+    u8 b;
+    u8 g;
+    u8 r;
+    u8 a;
+};
+
+// Turns PPU framebuffers ((emphasis << 6) | palette index per pixel) into
+// window pixels through a lookup table covering every emphasis setting
+namespace FrameConversion
+{
+    using SystemPalette = Array<WindowPixel, SYSTEM_PALETTE_LENGTH>;
+    using Lut = Array<WindowPixel, EMPHASIS_PALETTE_LENGTH>;
+
+    // Derives the emphasized colors from the 64 base colors, each set
+    // emphasis bit dimming the other two channels
+    void BuildLut(const SystemPalette& palette, Lut& lut);
+
+    // Converts a width x height frame, writing the rows bottom-up when
+    // flipVertical is set. Uses the fastest kernel the CPU supports.
+    void Convert(const u16* src, WindowPixel* dst, usize width, usize height, const Lut& lut, bool flipVertical);
+
+    // Portable version of Convert, always available
+    void ConvertScalar(const u16* src, WindowPixel* dst, usize width, usize height, const Lut& lut, bool flipVertical);
+
+    // Name of the kernel Convert uses on this CPU
+    const char* GetKernelName();
+}
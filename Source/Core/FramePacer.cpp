@@ -0,0 +1,108 @@
+#include "FramePacer.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Spin for at least this long before every deadline, and never for longer
+// than the maximum however badly the OS oversleeps
+static constexpr FramePacer::Clock::duration MIN_SPIN_MARGIN = std::chrono::microseconds(500);
+static constexpr FramePacer::Clock::duration MAX_SPIN_MARGIN = std::chrono::milliseconds(4);
+// Kept on top of the latest oversleep
+static constexpr FramePacer::Clock::duration SPIN_SLACK = std::chrono::microseconds(250);
+
+FramePacer::FramePacer(double period) : m_Period(period), m_SpinMargin(MAX_SPIN_MARGIN)
+{
+    Reset();
+}
+
+void FramePacer::Reset()
+{
+    Resync(Clock::now());
+}
+
+void FramePacer::Resync(Clock::time_point now)
+{
+    m_Start = now;
+    m_LastWake = now;
+    m_Frame = 0;
+}
+
+void FramePacer::WaitForNextFrame()
+{
+    m_Frame++;
+    const Clock::time_point deadline = m_Start + std::chrono::duration_cast<Clock::duration>(m_Period * m_Frame);
+
+    Clock::time_point now = Clock::now();
+    if (now - deadline > m_Period * MAX_LAG_FRAMES)
+    {
+        // The long interval still goes in the histogram, it was a visible hitch
+        RecordInterval(now - m_LastWake);
+        Resync(now);
+        m_ResyncCount++;
+        return;
+    }
+
+    SleepUntil(deadline);
+    now = Clock::now();
+    RecordInterval(now - m_LastWake);
+    m_LastWake = now;
+}
+
+void FramePacer::SleepUntil(Clock::time_point deadline)
+{
+    const Clock::time_point wakeAt = deadline - m_SpinMargin;
+    if (Clock::now() < wakeAt)
+    {
+        std::this_thread::sleep_until(wakeAt);
+
+        // Grow the margin straight away after a bad oversleep, shrink it
+        // slowly after good ones
+        const Clock::duration target = std::clamp(Clock::now() - wakeAt + SPIN_SLACK, MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+        m_SpinMargin = target > m_SpinMargin ? target : m_SpinMargin - (m_SpinMargin - target) / 16;
+    }
+
+    while (Clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::RecordInterval(Clock::duration interval)
+{
+    const double error = std::chrono::duration<double>(interval).count() - m_Period.count();
+    m_ErrorSum += error;
+    m_ErrorSquaredSum += error * error;
+    m_MaxError = std::max(m_MaxError, std::abs(error));
+
+    const i64 bucket = std::llround(error * 1e6 / HISTOGRAM_BUCKET_US) + HISTOGRAM_BUCKETS / 2;
+    m_Histogram[std::clamp<i64>(bucket, 0, HISTOGRAM_BUCKETS - 1)]++;
+    m_IntervalCount++;
+}
+
+void FramePacer::LogStats() const
+{
+    if (m_IntervalCount == 0)
+    {
+        return;
+    }
+
+    const double mean = m_ErrorSum / m_IntervalCount;
+    const double stddev = std::sqrt(std::max(0.0, m_ErrorSquaredSum / m_IntervalCount - mean * mean));
+    LOG_INFO("Frame pacing: %llu intervals of %.4f ms, error mean %+.4f ms, stddev %.4f ms, max %.4f ms, %llu resyncs",
+             static_cast<unsigned long long>(m_IntervalCount), m_Period.count() * 1e3, mean * 1e3, stddev * 1e3,
+             m_MaxError * 1e3, static_cast<unsigned long long>(m_ResyncCount));
+
+    for (u32 i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (m_Histogram[i] == 0)
+        {
+            continue;
+        }
+        const char* bound = i == 0 ? "<=" : i == HISTOGRAM_BUCKETS - 1 ? ">=" : "  ";
+        const i64 errorUs = (static_cast<i64>(i) - HISTOGRAM_BUCKETS / 2) * HISTOGRAM_BUCKET_US;
+        LOG_INFO("  %s %+6lld us: %8llu %6.2f%%", bound, static_cast<long long>(errorUs),
+                 static_cast<unsigned long long>(m_Histogram[i]), 100.0 * m_Histogram[i] / m_IntervalCount);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Common.h"
+
+#include <chrono>
+
+// Paces a loop to a fixed frame period. Every deadline is the start of the
+// schedule plus a whole number of periods, not the previous wake-up plus
+// one, so neither rounding nor a late wake-up accumulates into drift. The
+// wait sleeps until shortly before the deadline and spins for the rest;
+// the spin margin follows how far the OS has recently overslept.
+class FramePacer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Histogram of each frame interval's deviation from the period, in
+    // HISTOGRAM_BUCKET_US wide buckets centred on 0. The two outermost
+    // buckets also count everything past them.
+    static constexpr u32 HISTOGRAM_BUCKETS = 61;
+    static constexpr i64 HISTOGRAM_BUCKET_US = 100;
+
+    // Falling this many frames behind restarts the schedule from now
+    // instead of running frames back to back to catch up
+    static constexpr u32 MAX_LAG_FRAMES = 4;
+
+    // period in seconds
+    explicit FramePacer(double period);
+
+    // Starts the schedule over from now, e.g. after the loop was paused
+    void Reset();
+
+    // Blocks until the next frame is due
+    void WaitForNextFrame();
+
+    u64 GetIntervalCount() const
+    {
+        return m_IntervalCount;
+    }
+
+    u64 GetResyncCount() const
+    {
+        return m_ResyncCount;
+    }
+
+    const Array<u64, HISTOGRAM_BUCKETS>& GetHistogram() const
+    {
+        return m_Histogram;
+    }
+
+    // Logs the interval error summary and every non-empty histogram bucket
+    void LogStats() const;
+
+  private:
+    void Resync(Clock::time_point now);
+
+    void SleepUntil(Clock::time_point deadline);
+
+    void RecordInterval(Clock::duration interval);
+
+  private:
+    std::chrono::duration<double> m_Period;
+    Clock::time_point m_Start{};
+    Clock::time_point m_LastWake{};
+    // Frames since m_Start
+    u64 m_Frame = 0;
+    Clock::duration m_SpinMargin;
+
+    Array<u64, HISTOGRAM_BUCKETS> m_Histogram{};
+    u64 m_IntervalCount = 0;
+    u64 m_ResyncCount = 0;
+    double m_ErrorSum = 0.0;
+    double m_ErrorSquaredSum = 0.0;
+    double m_MaxError = 0.0;
+};
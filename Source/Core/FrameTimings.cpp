@@ -0,0 +1,111 @@
+#include "FrameTimings.h"
+#include "Logger.h"
+
+#include <cstdio>
+#include <fstream>
+
+FrameTimings::FrameTimings(std::span<const char* const> stageNames, usize windowFrames)
+    : m_StageNames(stageNames), m_Frames(std::max<usize>(windowFrames, 1)), m_Scratch(m_Frames.size())
+{
+    ASSERT(stageNames.size() <= MAX_STAGES);
+}
+
+void FrameTimings::AddFrame(const Frame& frame)
+{
+    m_Frames[m_Next] = frame;
+    m_Next = (m_Next + 1) % m_Frames.size();
+    m_Count = std::min(m_Count + 1, m_Frames.size());
+    m_FrameCount++;
+}
+
+u32 FrameTimings::FrameTotal(const Frame& frame) const
+{
+    u64 total = 0;
+    for (u32 stage = 0; stage < GetStageCount(); stage++)
+    {
+        total += frame[stage];
+    }
+    return static_cast<u32>(std::min<u64>(total, ~0u));
+}
+
+FrameTimings::Stats FrameTimings::GetStats(u32 stage) const
+{
+    if (m_Count == 0)
+    {
+        return {};
+    }
+
+    for (usize i = 0; i < m_Count; i++)
+    {
+        const Frame& frame = GetFrame(i);
+        m_Scratch[i] = stage < GetStageCount() ? frame[stage] : FrameTotal(frame);
+    }
+
+    // Nearest rank, so p99 of fewer than 100 frames is the slowest one
+    const auto select = [&](usize rank) {
+        const auto nth = m_Scratch.begin() + rank;
+        std::nth_element(m_Scratch.begin(), nth, m_Scratch.begin() + m_Count);
+        return *nth / 1e6;
+    };
+
+    Stats stats{};
+    stats.maxMs = select(m_Count - 1);
+    stats.p99Ms = select((m_Count * 99 + 99) / 100 - 1);
+    stats.p50Ms = select((m_Count + 1) / 2 - 1);
+    return stats;
+}
+
+void FrameTimings::LogStats(const char* label) const
+{
+    Array<char, 384> line{};
+    usize length = 0;
+    const auto append = [&](const char* name, const Stats& stats) {
+        const int written = std::snprintf(line.data() + length, line.size() - length, " %s %.2f/%.2f/%.2f", name,
+                                          stats.p50Ms, stats.p99Ms, stats.maxMs);
+        length = std::min(length + std::max(written, 0), line.size() - 1);
+    };
+
+    append("frame", GetStats(GetStageCount()));
+    for (u32 stage = 0; stage < GetStageCount(); stage++)
+    {
+        append(m_StageNames[stage], GetStats(stage));
+    }
+    LOG_INFO("%s timings over %llu frames, p50/p99/max ms:%s", label, static_cast<unsigned long long>(m_Count),
+             line.data());
+}
+
+bool FrameTimings::ExportCsv(const std::filesystem::path& path) const
+{
+    std::ofstream outf{path, std::ios::trunc};
+    if (!outf)
+    {
+        return false;
+    }
+
+    outf << "frame";
+    for (u32 stage = 0; stage < GetStageCount(); stage++)
+    {
+        outf << ',' << m_StageNames[stage] << "_us";
+    }
+    outf << ",total_us\n";
+
+    Array<char, 32> value{};
+    const auto writeUs = [&](u32 ns) {
+        std::snprintf(value.data(), value.size(), ",%.3f", ns / 1e3);
+        outf << value.data();
+    };
+
+    const u64 first = m_FrameCount - m_Count;
+    for (usize i = 0; i < m_Count; i++)
+    {
+        const Frame& frame = GetFrame(i);
+        outf << first + i;
+        for (u32 stage = 0; stage < GetStageCount(); stage++)
+        {
+            writeUs(frame[stage]);
+        }
+        writeUs(FrameTotal(frame));
+        outf << '\n';
+    }
+    return static_cast<bool>(outf);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Where each frame of a loop spent its time, stage by stage, over the last
+// few hundred frames: enough to tell whether a slow frame was slow in
+// emulation, in presentation or in the wait for the next one. Recording a
+// frame is a clock read per stage and a copy into a ring allocated up
+// front; the percentiles are only worked out when asked for.
+class FrameTimings
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr u32 MAX_STAGES = 8;
+
+    // One frame's time in each stage in nanoseconds, small enough to pass
+    // between threads by value
+    using Frame = Array<u32, MAX_STAGES>;
+
+    struct Stats
+    {
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    // Charges the time since the previous lap, or since construction, to a
+    // stage. Lapping at the end of every stage leaves none of the loop's
+    // time unaccounted for.
+    class Stopwatch
+    {
+      public:
+        void Lap(Frame& frame, u32 stage)
+        {
+            const Clock::time_point now = Clock::now();
+            const i64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_Last).count();
+            frame[stage] += static_cast<u32>(std::min<i64>(ns, ~0u - frame[stage]));
+            m_Last = now;
+        }
+
+      private:
+        Clock::time_point m_Last = Clock::now();
+    };
+
+    // stageNames isn't copied and has to outlive this, at most MAX_STAGES
+    FrameTimings(std::span<const char* const> stageNames, usize windowFrames);
+
+    void AddFrame(const Frame& frame);
+
+    u32 GetStageCount() const
+    {
+        return static_cast<u32>(m_StageNames.size());
+    }
+
+    // Frames added in total, not only those in the window
+    u64 GetFrameCount() const
+    {
+        return m_FrameCount;
+    }
+
+    // Over the frames in the window. GetStageCount() as the stage gives
+    // the whole frame.
+    Stats GetStats(u32 stage) const;
+
+    // One line with every stage's p50/p99/max
+    void LogStats(const char* label) const;
+
+    // The window oldest first, a row per frame in microseconds
+    [[nodiscard]] bool ExportCsv(const std::filesystem::path& path) const;
+
+  private:
+    u32 FrameTotal(const Frame& frame) const;
+
+    // i-th oldest frame in the window
+    const Frame& GetFrame(usize i) const
+    {
+        return m_Frames[(m_Next + m_Frames.size() - m_Count + i) % m_Frames.size()];
+    }
+
+  private:
+    std::span<const char* const> m_StageNames{};
+    std::vector<Frame> m_Frames{};
+    // Slot the next frame goes in
+    usize m_Next = 0;
+    // Frames in the window, up to m_Frames.size()
+    usize m_Count = 0;
+    u64 m_FrameCount = 0;
+
+    // For selecting percentiles without allocating
+    mutable std::vector<u32> m_Scratch{};
+};
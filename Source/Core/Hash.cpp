@@ -0,0 +1,104 @@
+#include "Hash.h"
+
+#include <bit>
+#include <cstring>
+
+static constexpr u64 PRIME1 = 0x9E3779B185EBCA87ull;
+static constexpr u64 PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr u64 PRIME3 = 0x165667B19E3779F9ull;
+static constexpr u64 PRIME4 = 0x85EBCA77C2B2AE63ull;
+static constexpr u64 PRIME5 = 0x27D4EB2F165667C5ull;
+
+// Loads are little endian, which every supported target is
+static u64 Read64(const u8* p)
+{
+    u64 val;
+    std::memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static u32 Read32(const u8* p)
+{
+    u32 val;
+    std::memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static u64 Round(u64 acc, u64 input)
+{
+    acc += input * PRIME2;
+    acc = std::rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static u64 MergeRound(u64 acc, u64 lane)
+{
+    acc ^= Round(0, lane);
+    return acc * PRIME1 + PRIME4;
+}
+
+namespace Hash
+{
+    u64 Hash64(const void* data, usize size, u64 seed)
+    {
+        const u8* p = static_cast<const u8*>(data);
+        const u8* end = p + size;
+
+        u64 hash;
+        if (size >= 32)
+        {
+            u64 v1 = seed + PRIME1 + PRIME2;
+            u64 v2 = seed + PRIME2;
+            u64 v3 = seed;
+            u64 v4 = seed - PRIME1;
+
+            const u8* limit = end - 32;
+            do
+            {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+            hash = MergeRound(hash, v1);
+            hash = MergeRound(hash, v2);
+            hash = MergeRound(hash, v3);
+            hash = MergeRound(hash, v4);
+        }
+        else
+        {
+            hash = seed + PRIME5;
+        }
+
+        hash += size;
+
+        while (end - p >= 8)
+        {
+            hash ^= Round(0, Read64(p));
+            hash = std::rotl(hash, 27) * PRIME1 + PRIME4;
+            p += 8;
+        }
+        if (end - p >= 4)
+        {
+            hash ^= Read32(p) * PRIME1;
+            hash = std::rotl(hash, 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        while (p < end)
+        {
+            hash ^= *p * PRIME5;
+            hash = std::rotl(hash, 11) * PRIME1;
+            p++;
+        }
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
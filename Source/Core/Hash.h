@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Hash
+{
+    // Non-cryptographic 64-bit hash (the xxHash64 algorithm), 8 bytes per
+    // step over four independent lanes. Results are the same on every
+    // platform, so they can be written to files and compared later.
+    u64 Hash64(const void* data, usize size, u64 seed = 0);
+}
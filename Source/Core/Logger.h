@@ -3,6 +3,7 @@
 #include "Common.h"
 
 #include <cstdio>
+#include <cstring>
 #include <string_view>
 
 enum class LogLevel
@@ -0,0 +1,99 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include "WindowsCommon.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+    Close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The view keeps the file mapped after both handles are closed
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view)
+        return false;
+
+    m_Data = static_cast<const u8*>(view);
+    m_Size = static_cast<usize>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+    Close();
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping holds its own reference to the file
+    void* view = mmap(nullptr, static_cast<usize>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    m_Data = static_cast<const u8*>(view);
+    m_Size = static_cast<usize>(info.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+    {
+        munmap(const_cast<u8*>(m_Data), m_Size);
+    }
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+#endif
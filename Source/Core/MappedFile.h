@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Common.h"
+
+#include <filesystem>
+
+// Read-only view of a whole file mapped into memory. Pages are only read
+// from disk when touched, and every mapping of the same file shares them
+// through the page cache.
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Fails for missing or empty files and when the platform can't map
+    // them; callers fall back to reading the file
+    [[nodiscard]] bool Open(const std::filesystem::path& path);
+
+    void Close();
+
+    const u8* GetData() const
+    {
+        return m_Data;
+    }
+
+    usize GetSize() const
+    {
+        return m_Size;
+    }
+
+  private:
+    const u8* m_Data = nullptr;
+    usize m_Size = 0;
+};
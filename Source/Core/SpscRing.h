@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <span>
+#include <vector>
+
+// Bounded queue from one producer thread to one consumer thread without
+// locks. Each side only ever stores its own position, so neither can
+// block the other and no priority inversion is possible: a real-time
+// consumer such as an audio callback never waits on the producer. Both
+// positions run freely and are masked into the buffer, whose size is the
+// capacity rounded up to a power of two. Each side keeps a copy of the
+// other's position and only reloads it when the copy says the ring is
+// full or empty.
+template <typename T> class SpscRing
+{
+  public:
+    explicit SpscRing(usize capacity) : m_Buffer(std::bit_ceil(capacity)), m_Mask(m_Buffer.size() - 1)
+    {
+    }
+
+    usize GetCapacity() const
+    {
+        return m_Buffer.size();
+    }
+
+    // Values written and not yet read. Either side may call it; the other
+    // side can change it straight after.
+    usize GetSize() const
+    {
+        const usize head = m_Head.load(std::memory_order_acquire);
+        return m_Tail.load(std::memory_order_acquire) - head;
+    }
+
+    // Producer side. Copies as many of values as there is room for and
+    // returns how many that was; the rest are the caller's to drop.
+    usize Write(std::span<const T> values)
+    {
+        const usize tail = m_Tail.load(std::memory_order_relaxed);
+        if (GetCapacity() - (tail - m_CachedHead) < values.size())
+        {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+        }
+        const usize count = std::min(values.size(), GetCapacity() - (tail - m_CachedHead));
+
+        const usize start = tail & m_Mask;
+        const usize first = std::min(count, GetCapacity() - start);
+        std::copy_n(values.data(), first, m_Buffer.data() + start);
+        std::copy_n(values.data() + first, count - first, m_Buffer.data());
+
+        m_Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side. Fills out with up to out.size() values, oldest first,
+    // and returns how many there were.
+    usize Read(std::span<T> out)
+    {
+        const usize head = m_Head.load(std::memory_order_relaxed);
+        if (m_CachedTail - head < out.size())
+        {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+        }
+        const usize count = std::min(out.size(), m_CachedTail - head);
+
+        const usize start = head & m_Mask;
+        const usize first = std::min(count, GetCapacity() - start);
+        std::copy_n(m_Buffer.data() + start, first, out.data());
+        std::copy_n(m_Buffer.data(), count - first, out.data() + first);
+
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+  private:
+    std::vector<T> m_Buffer{};
+    const usize m_Mask = 0;
+
+    // Producer's line: its position and its copy of the consumer's
+    alignas(CACHE_LINE_SIZE) std::atomic<usize> m_Tail{0};
+    usize m_CachedHead = 0;
+
+    // Consumer's line
+    alignas(CACHE_LINE_SIZE) std::atomic<usize> m_Head{0};
+    usize m_CachedTail = 0;
+};
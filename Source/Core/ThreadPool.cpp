@@ -0,0 +1,115 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(u32 threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_ThreadCount = threadCount;
+    m_Blocks = std::make_unique<Block[]>(threadCount);
+
+    m_Workers.reserve(threadCount - 1);
+    for (u32 i = 1; i < threadCount; i++)
+    {
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_WakeCv.notify_all();
+    for (std::thread& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(usize count, const std::function<void(usize)>& task)
+{
+    if (count == 0)
+        return;
+
+    if (m_Workers.empty() || count == 1)
+    {
+        for (usize i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    // Blocks are only written while every worker is asleep, the mutex
+    // publishes them
+    for (u32 i = 0; i < m_ThreadCount; i++)
+    {
+        m_Blocks[i].next.store(count * i / m_ThreadCount, std::memory_order_relaxed);
+        m_Blocks[i].end = count * (i + 1) / m_ThreadCount;
+    }
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Task = &task;
+        m_Busy = static_cast<u32>(m_Workers.size());
+        m_Generation++;
+    }
+    m_WakeCv.notify_all();
+
+    RunBlocks(0);
+
+    std::unique_lock lock(m_Mutex);
+    m_DoneCv.wait(lock, [this] { return m_Busy == 0; });
+    m_Task = nullptr;
+}
+
+void ThreadPool::WorkerLoop(u32 index)
+{
+    u64 seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_Mutex);
+            m_WakeCv.wait(lock, [&] { return m_Stop || m_Generation != seen; });
+            if (m_Stop)
+                return;
+            seen = m_Generation;
+        }
+
+        RunBlocks(index);
+
+        bool last;
+        {
+            std::lock_guard lock(m_Mutex);
+            last = --m_Busy == 0;
+        }
+        if (last)
+        {
+            m_DoneCv.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunBlocks(u32 index)
+{
+    const std::function<void(usize)>& task = *m_Task;
+
+    // Own block first, then the others starting from the next one over so
+    // thieves spread out instead of all hitting block 0
+    for (u32 offset = 0; offset < m_ThreadCount; offset++)
+    {
+        Block& block = m_Blocks[(index + offset) % m_ThreadCount];
+        while (true)
+        {
+            const usize i = block.next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= block.end)
+                break;
+            task(i);
+        }
+    }
+}
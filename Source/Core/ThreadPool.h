@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork-join loops. ParallelFor splits the
+// index range into one contiguous block per thread; a thread that runs out
+// takes indices from the other blocks, so a slow item doesn't hold up the
+// rest. The same index lands on the same thread from one call to the next
+// unless it was stolen, which keeps per-item data in that core's cache.
+class ThreadPool
+{
+  public:
+    // 0 uses one thread per hardware thread. The thread calling ParallelFor
+    // counts as one of them, so threadCount - 1 workers are started.
+    explicit ThreadPool(u32 threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    u32 GetThreadCount() const
+    {
+        return m_ThreadCount;
+    }
+
+    // Calls task(i) for every i in [0, count) and returns when all calls
+    // have. Only one thread may call this at a time.
+    void ParallelFor(usize count, const std::function<void(usize)>& task);
+
+  private:
+    struct alignas(CACHE_LINE_SIZE) Block
+    {
+        std::atomic<usize> next{0};
+        usize end = 0;
+    };
+
+    void WorkerLoop(u32 index);
+
+    // Drains this thread's block, then steals from the others
+    void RunBlocks(u32 index);
+
+  private:
+    u32 m_ThreadCount = 1;
+    std::vector<std::thread> m_Workers{};
+    std::unique_ptr<Block[]> m_Blocks{};
+
+    const std::function<void(usize)>* m_Task = nullptr;
+
+    std::mutex m_Mutex{};
+    std::condition_variable m_WakeCv{};
+    std::condition_variable m_DoneCv{};
+    u64 m_Generation = 0;
+    u32 m_Busy = 0;
+    bool m_Stop = false;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+
+// Hands the newest of a stream of values from one producer thread to one
+// consumer thread without locks. The producer owns one of the three
+// buffers, the consumer owns another and the third sits between them;
+// publishing and acquiring each swap a buffer with the middle one in a
+// single atomic exchange. Neither side ever waits for the other. A value
+// the consumer doesn't pick up before the next Publish is replaced, so
+// the consumer only ever sees the newest one.
+template <typename T> class TripleBuffer
+{
+  public:
+    // Producer side. Holds whatever was written to it three publishes
+    // ago, not the last published value.
+    T& GetWriteBuffer()
+    {
+        return m_Buffers[m_Back];
+    }
+
+    // Makes the write buffer the newest value and swaps in a free one to
+    // write next. Returns false if this replaced a value the consumer never
+    // acquired, i.e. that value was dropped.
+    bool Publish()
+    {
+        const u32 previous = m_Middle.exchange(m_Back | FRESH_BIT, std::memory_order_acq_rel);
+        m_Back = previous & INDEX_MASK;
+        return !(previous & FRESH_BIT);
+    }
+
+    // Consumer side. Swaps in the newest value if one was published since
+    // the last call, returns false and keeps the current one otherwise.
+    bool Acquire()
+    {
+        if (!(m_Middle.load(std::memory_order_relaxed) & FRESH_BIT))
+        {
+            return false;
+        }
+        m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& GetReadBuffer() const
+    {
+        return m_Buffers[m_Front];
+    }
+
+  private:
+    static constexpr u32 INDEX_MASK = 0x3;
+    static constexpr u32 FRESH_BIT = 0x4;
+
+    Array<T, 3> m_Buffers{};
+
+    // Kept on separate lines so each side only touches its own index and
+    // the shared one
+    alignas(CACHE_LINE_SIZE) u32 m_Back = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<u32> m_Middle{1};
+    alignas(CACHE_LINE_SIZE) u32 m_Front = 2;
+};
@@ -0,0 +1,86 @@
+#include "WavWriter.h"
+
+#include <algorithm>
+
+static constexpr usize HEADER_SIZE = 44;
+static constexpr u16 BITS_PER_SAMPLE = 16;
+static constexpr u16 FORMAT_PCM = 1;
+static constexpr u16 CHANNELS = 1;
+
+static void PutU16(u8*& out, u16 val)
+{
+    *out++ = static_cast<u8>(val);
+    *out++ = static_cast<u8>(val >> 8);
+}
+
+static void PutU32(u8*& out, u32 val)
+{
+    PutU16(out, static_cast<u16>(val));
+    PutU16(out, static_cast<u16>(val >> 16));
+}
+
+static void PutTag(u8*& out, const char (&tag)[5])
+{
+    out = std::copy_n(tag, 4, out);
+}
+
+WavWriter::~WavWriter()
+{
+    [[maybe_unused]] const bool closed = Close();
+}
+
+bool WavWriter::Open(const std::filesystem::path& path, u32 sampleRate)
+{
+    [[maybe_unused]] const bool closed = Close();
+
+    m_File.open(path, std::ios::binary | std::ios::trunc);
+    m_SampleRate = sampleRate;
+    m_SampleCount = 0;
+    return m_File && WriteHeader();
+}
+
+bool WavWriter::Write(std::span<const i16> samples)
+{
+    // Written as is, .wav is little-endian like every platform this runs on
+    m_File.write(reinterpret_cast<const char*>(samples.data()), samples.size_bytes());
+    m_SampleCount += samples.size();
+    return static_cast<bool>(m_File);
+}
+
+bool WavWriter::Close()
+{
+    if (!m_File.is_open())
+    {
+        return true;
+    }
+    m_File.seekp(0);
+    const bool written = WriteHeader();
+    m_File.close();
+    return written && m_File;
+}
+
+bool WavWriter::WriteHeader()
+{
+    constexpr u32 BYTES_PER_SAMPLE = CHANNELS * BITS_PER_SAMPLE / 8;
+    // Past 4GB the sizes can't be represented; players read on regardless
+    const u32 dataSize = static_cast<u32>(std::min<u64>(m_SampleCount * BYTES_PER_SAMPLE, ~0u - HEADER_SIZE));
+
+    Array<u8, HEADER_SIZE> header{};
+    u8* out = header.data();
+    PutTag(out, "RIFF");
+    PutU32(out, static_cast<u32>(HEADER_SIZE - 8 + dataSize));
+    PutTag(out, "WAVE");
+    PutTag(out, "fmt ");
+    PutU32(out, 16);
+    PutU16(out, FORMAT_PCM);
+    PutU16(out, CHANNELS);
+    PutU32(out, m_SampleRate);
+    PutU32(out, m_SampleRate * BYTES_PER_SAMPLE);
+    PutU16(out, BYTES_PER_SAMPLE);
+    PutU16(out, BITS_PER_SAMPLE);
+    PutTag(out, "data");
+    PutU32(out, dataSize);
+
+    m_File.write(reinterpret_cast<const char*>(header.data()), header.size());
+    return static_cast<bool>(m_File);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Common.h"
+
+#include <filesystem>
+#include <fstream>
+#include <span>
+
+// Streams mono 16-bit PCM into a .wav file. Samples go straight to the
+// file as they come; Close fills in the sizes in the header, which are
+// left at 0 until then.
+class WavWriter
+{
+  public:
+    ~WavWriter();
+
+    [[nodiscard]] bool Open(const std::filesystem::path& path, u32 sampleRate);
+
+    [[nodiscard]] bool Write(std::span<const i16> samples);
+
+    // Also called by the destructor, which can't report a failure
+    [[nodiscard]] bool Close();
+
+    u64 GetSampleCount() const
+    {
+        return m_SampleCount;
+    }
+
+  private:
+    bool WriteHeader();
+
+  private:
+    std::ofstream m_File{};
+    u32 m_SampleRate = 0;
+    u64 m_SampleCount = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Common.h"
+#include "FrameConversion.h"
 #include "WindowsCommon.h"
 #include "Input.h"
 #include <string>
@@ -19,14 +20,6 @@ struct WindowSpec
 	int renderHeight;
 };
 
-struct WindowPixel
-{
-	u8 b;
-	u8 g;
-	u8 r;
-	u8 a;
-};
-
 using KeyCallback = std::function<void(KeyEvent)>;
 
 using MouseMoveCallback = std::function<void(MouseMoveEvent)>;
@@ -0,0 +1,360 @@
+#include "../Core/Common.h"
+#include "../Core/FramePacer.h"
+#include "../Core/FrameTimings.h"
+#include "../Core/Hash.h"
+#include "../Core/Logger.h"
+#include "../Core/WavWriter.h"
+#include "../NES/Movie.h"
+#include "../NES/NES.h"
+#include "../NES/RunAhead.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Batch runner: loads a ROM, runs it with no window and by default no frame
+// limiter, then reports how long the emulation took. Can play back a movie and
+// check its state hashes, or record the run to one, and write the sound to a
+// .wav file.
+
+static constexpr u64 DEFAULT_FRAMES = 600;
+static constexpr u32 DEFAULT_SAMPLE_RATE = 48000;
+
+enum HeadlessStage : u32
+{
+	STAGE_STEP,
+	STAGE_CHECK,
+	STAGE_AUDIO,
+	STAGE_SLEEP
+};
+static constexpr Array<const char*, 4> STAGE_NAMES = { "step", "check", "audio", "sleep" };
+// Frames kept for the timing percentiles when they aren't exported
+static constexpr usize TIMING_WINDOW_FRAMES = 600;
+
+struct HeadlessOptions
+{
+	const char* romPath = nullptr;
+	u64 frames = DEFAULT_FRAMES;
+	SchedulerMode scheduler = SchedulerMode::CatchUp;
+	CpuExecutionMode cpuMode = CpuExecutionMode::Instruction;
+	u32 runAhead = 0;
+	u32 frameSkip = 0;
+	const char* moviePath = nullptr;
+	const char* recordPath = nullptr;
+	const char* wavPath = nullptr;
+	const char* timingsPath = nullptr;
+	u32 sampleRate = DEFAULT_SAMPLE_RATE;
+	u32 inputSeed = 0;
+	bool frameHashes = false;
+	bool realtime = false;
+	bool quiet = false;
+};
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: nes-headless <rom> [options]\n"
+		"  --frames <n>          Number of frames to emulate (default %llu)\n"
+		"  --scheduler <mode>    lockstep or catchup (default catchup)\n"
+		"  --cpu <mode>          cycle or instruction (default instruction,\n"
+		"                        only used with the catchup scheduler)\n"
+		"  --run-ahead <n>       Show the frame n frames ahead (default 0)\n"
+		"  --frame-skip <n>      Render one frame in every n + 1 (default 0)\n"
+		"  --movie <file>        Play back a movie, checking its state hashes;\n"
+		"                        runs for the movie's length\n"
+		"  --record <file>       Record the run to a movie\n"
+		"  --wav <file>          Write the sound to a 16-bit mono .wav file\n"
+		"  --sample-rate <n>     Sample rate for --wav (default %u)\n"
+		"  --input-seed <n>      Press pseudo-random buttons derived from n\n"
+		"                        instead of none\n"
+		"  --frame-hashes        Print a framebuffer hash after every rendered\n"
+		"                        frame\n"
+		"  --realtime            Pace frames at the NTSC rate and report the\n"
+		"                        frame interval error\n"
+		"  --timings <file>      Write every frame's time per stage to a CSV\n"
+		"                        file and report percentiles\n"
+		"  --quiet               Only print errors\n",
+		static_cast<unsigned long long>(DEFAULT_FRAMES),
+		DEFAULT_SAMPLE_RATE);
+}
+
+static bool ParseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		if (std::strcmp(arg, "--frames") == 0 && i + 1 < argc)
+		{
+			options.frames = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(arg, "--scheduler") == 0 && i + 1 < argc)
+		{
+			const char* mode = argv[++i];
+			if (std::strcmp(mode, "lockstep") == 0)
+				options.scheduler = SchedulerMode::Lockstep;
+			else if (std::strcmp(mode, "catchup") == 0)
+				options.scheduler = SchedulerMode::CatchUp;
+			else
+				return false;
+		}
+		else if (std::strcmp(arg, "--cpu") == 0 && i + 1 < argc)
+		{
+			const char* mode = argv[++i];
+			if (std::strcmp(mode, "cycle") == 0)
+				options.cpuMode = CpuExecutionMode::Cycle;
+			else if (std::strcmp(mode, "instruction") == 0)
+				options.cpuMode = CpuExecutionMode::Instruction;
+			else
+				return false;
+		}
+		else if (std::strcmp(arg, "--run-ahead") == 0 && i + 1 < argc)
+		{
+			options.runAhead = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--frame-skip") == 0 && i + 1 < argc)
+		{
+			options.frameSkip = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--movie") == 0 && i + 1 < argc)
+		{
+			options.moviePath = argv[++i];
+		}
+		else if (std::strcmp(arg, "--record") == 0 && i + 1 < argc)
+		{
+			options.recordPath = argv[++i];
+		}
+		else if (std::strcmp(arg, "--wav") == 0 && i + 1 < argc)
+		{
+			options.wavPath = argv[++i];
+		}
+		else if (std::strcmp(arg, "--sample-rate") == 0 && i + 1 < argc)
+		{
+			options.sampleRate = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--input-seed") == 0 && i + 1 < argc)
+		{
+			options.inputSeed = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--frame-hashes") == 0)
+		{
+			options.frameHashes = true;
+		}
+		else if (std::strcmp(arg, "--timings") == 0 && i + 1 < argc)
+		{
+			options.timingsPath = argv[++i];
+		}
+		else if (std::strcmp(arg, "--realtime") == 0)
+		{
+			options.realtime = true;
+		}
+		else if (std::strcmp(arg, "--quiet") == 0)
+		{
+			options.quiet = true;
+		}
+		else if (arg[0] != '-' && !options.romPath)
+		{
+			options.romPath = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	// A movie brings its own input
+	return options.romPath != nullptr && !(options.moviePath && (options.recordPath || options.inputSeed)) &&
+		   options.sampleRate > 0;
+}
+
+// Only used to compare frames between runs
+static u64 HashFramebuffer(const u16* framebuffer)
+{
+	return Hash::Hash64(framebuffer, PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT * sizeof(u16));
+}
+
+// Buttons held for 8 frames at a time, 0 without a seed
+static u8 SeededInput(u32 seed, u64 frame)
+{
+	if (!seed)
+	{
+		return 0;
+	}
+	u32 val = static_cast<u32>((frame / 8) * 2654435761u) ^ (seed * 40503u);
+	val ^= val >> 15;
+	return static_cast<u8>(val * 2246822519u >> 24);
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions options{};
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	g_Logger.Init();
+	g_Logger.SetOut(stderr);
+	g_Logger.SetLogLevel(options.quiet ? LogLevel::Error : LogLevel::Info);
+
+	auto nes = std::make_unique<NES>();
+	if (!nes->LoadROM(options.romPath))
+	{
+		return 1;
+	}
+	nes->SetSchedulerMode(options.scheduler);
+	nes->SetCpuExecutionMode(options.cpuMode);
+	nes->SetFrameSkip(options.frameSkip);
+	nes->Reset();
+
+	RunAhead runAhead(nes->GetSaveStateSize(), options.runAhead);
+
+	Movie movie;
+	if (options.moviePath)
+	{
+		const MovieResult result = movie.Load(options.moviePath);
+		if (result != MovieResult::Success)
+		{
+			LOG_ERROR("Failed to load movie %s (error %d)", options.moviePath, static_cast<int>(result));
+			return 1;
+		}
+		if (!movie.MatchesRom(*nes->GetCartridge().GetImage()))
+		{
+			LOG_ERROR("Movie %s was recorded with a different ROM", options.moviePath);
+			return 1;
+		}
+		options.frames = movie.GetFrameCount();
+	}
+	else if (options.recordPath)
+	{
+		movie.Begin(*nes->GetCartridge().GetImage());
+	}
+	const bool checkHashes = options.moviePath && movie.HasStateHashes();
+
+	// Written frame by frame as fast as the emulation goes, or paced with
+	// --realtime; either way the samples are the same
+	WavWriter wav;
+	std::vector<i16> samples;
+	if (options.wavPath)
+	{
+		if (!wav.Open(options.wavPath, options.sampleRate))
+		{
+			LOG_ERROR("Failed to open %s for writing", options.wavPath);
+			return 1;
+		}
+		nes->SetAudioSampleRate(options.sampleRate);
+		samples.resize(options.sampleRate / 10);
+	}
+
+	FramePacer pacer{ NES::FRAME_TIME };
+
+	// Exported runs keep every frame, the rest only the percentiles' window
+	FrameTimings timings{ STAGE_NAMES, options.timingsPath ? options.frames : TIMING_WINDOW_FRAMES };
+	FrameTimings::Stopwatch stopwatch;
+
+	using clock = std::chrono::steady_clock;
+	const auto begin = clock::now();
+
+	for (u64 frame = 0; frame < options.frames; frame++)
+	{
+		FrameTimings::Frame times{};
+		const u8 buttons = options.moviePath ? movie.GetButtons(frame) : SeededInput(options.inputSeed, frame);
+		if (options.moviePath)
+		{
+			movie.ApplyFrame(*nes, frame);
+		}
+		else
+		{
+			nes->SetButtonsState(buttons);
+		}
+
+		runAhead.StepFrame(*nes);
+		stopwatch.Lap(times, STAGE_STEP);
+
+		if (checkHashes && nes->GetStateHash() != movie.GetStateHash(frame))
+		{
+			LOG_ERROR("Desynced from movie at frame %llu", static_cast<unsigned long long>(frame));
+			return 2;
+		}
+		if (options.recordPath)
+		{
+			movie.AddFrame(buttons, false, nes->GetStateHash());
+		}
+		if (options.frameHashes && nes->FrameRendered())
+		{
+			printf("frame %llu %016llx\n",
+				   static_cast<unsigned long long>(frame),
+				   static_cast<unsigned long long>(HashFramebuffer(nes->GetFramebuffer())));
+		}
+		stopwatch.Lap(times, STAGE_CHECK);
+
+		if (options.wavPath)
+		{
+			usize count = 0;
+			while ((count = nes->ReadAudioSamples(samples)) > 0)
+			{
+				if (!wav.Write(std::span<const i16>(samples.data(), count)))
+				{
+					LOG_ERROR("Failed to write to %s", options.wavPath);
+					return 1;
+				}
+			}
+		}
+		stopwatch.Lap(times, STAGE_AUDIO);
+
+		if (options.realtime)
+		{
+			pacer.WaitForNextFrame();
+		}
+		stopwatch.Lap(times, STAGE_SLEEP);
+		timings.AddFrame(times);
+	}
+
+	const auto end = clock::now();
+	const double seconds = std::chrono::duration<double>(end - begin).count();
+
+	if (options.recordPath)
+	{
+		const MovieResult result = movie.Save(options.recordPath);
+		if (result != MovieResult::Success)
+		{
+			LOG_ERROR("Failed to save movie %s (error %d)", options.recordPath, static_cast<int>(result));
+			return 1;
+		}
+	}
+	if (options.wavPath)
+	{
+		if (!wav.Close())
+		{
+			LOG_ERROR("Failed to finish %s", options.wavPath);
+			return 1;
+		}
+		LOG_INFO("Wrote %llu samples at %u Hz to %s", static_cast<unsigned long long>(wav.GetSampleCount()),
+				 options.sampleRate, options.wavPath);
+	}
+	if (options.realtime)
+	{
+		pacer.LogStats();
+	}
+	if (options.timingsPath)
+	{
+		if (!timings.ExportCsv(options.timingsPath))
+		{
+			LOG_ERROR("Failed to write timings to %s", options.timingsPath);
+			return 1;
+		}
+		timings.LogStats("Frame");
+	}
+	const double fps = seconds > 0.0 ? options.frames / seconds : 0.0;
+
+	printf("frames=%llu cycles=%llu time=%.3fs fps=%.1f ms/frame=%.4f speed=%.2fx hash=%016llx\n",
+		   static_cast<unsigned long long>(options.frames),
+		   static_cast<unsigned long long>(nes->GetCpu().GetCycle()),
+		   seconds,
+		   fps,
+		   options.frames ? seconds * 1000.0 / options.frames : 0.0,
+		   fps * NES::FRAME_TIME,
+		   static_cast<unsigned long long>(HashFramebuffer(nes->GetFramebuffer())));
+
+	return 0;
+}
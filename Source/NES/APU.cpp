@@ -0,0 +1,797 @@
+#include "APU.h"
+
+#include "CPU.h"
+#include "CPUBus.h"
+#include "SaveState.h"
+#include "SystemCommon.h"
+
+#include <algorithm>
+
+static constexpr Array<u8, 32> LENGTH_TABLE = {
+	10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+	12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+// Sequencer output for each step of each duty setting, step 0 in the top bit
+static constexpr Array<u8, 4> DUTY_SEQUENCES = { 0b01000000, 0b01100000, 0b01111000, 0b10011111 };
+
+// NTSC timer periods in CPU cycles
+static constexpr Array<u16, 16> NOISE_PERIODS = {
+	4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+static constexpr Array<u16, 16> DMC_RATES = {
+	428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+enum FrameAction : u8
+{
+	QUARTER_FRAME = 1 << 0,
+	HALF_FRAME = 1 << 1,
+	FRAME_IRQ = 1 << 2
+};
+
+struct FrameStep
+{
+	u32 cycle = 0;
+	u8 actions = 0;
+};
+
+// Frame counter steps in CPU cycles from the start of the sequence, which
+// restarts after the last one
+static constexpr Array<FrameStep, 6> FOUR_STEP_SEQUENCE = { {
+	{ 7457, QUARTER_FRAME },
+	{ 14913, QUARTER_FRAME | HALF_FRAME },
+	{ 22371, QUARTER_FRAME },
+	{ 29828, FRAME_IRQ },
+	{ 29829, QUARTER_FRAME | HALF_FRAME | FRAME_IRQ },
+	{ 29830, FRAME_IRQ }
+} };
+static constexpr Array<FrameStep, 4> FIVE_STEP_SEQUENCE = { {
+	{ 7457, QUARTER_FRAME },
+	{ 14913, QUARTER_FRAME | HALF_FRAME },
+	{ 22371, QUARTER_FRAME },
+	{ 37281, QUARTER_FRAME | HALF_FRAME }
+} };
+static constexpr u32 FOUR_STEP_LENGTH = 29830;
+static constexpr u32 FIVE_STEP_LENGTH = 37282;
+
+static constexpr i32 ToLevelUnits(double weight)
+{
+	return static_cast<i32>(weight * 32768.0 + 0.5);
+}
+
+static constexpr i32 PULSE_UNITS = ToLevelUnits(APU::PULSE_WEIGHT);
+static constexpr i32 TRIANGLE_UNITS = ToLevelUnits(APU::TRIANGLE_WEIGHT);
+static constexpr i32 NOISE_UNITS = ToLevelUnits(APU::NOISE_WEIGHT);
+static constexpr i32 DMC_UNITS = ToLevelUnits(APU::DMC_WEIGHT);
+
+static std::span<const FrameStep> GetFrameSequence(bool fiveStep)
+{
+	if (fiveStep)
+	{
+		return FIVE_STEP_SEQUENCE;
+	}
+	return FOUR_STEP_SEQUENCE;
+}
+
+// Counts timer down by span cycles, reloading it with period every time it
+// runs out, and returns how many times it did
+static u64 AdvanceTimer(u32& timer, u32 period, u64 span)
+{
+	if (span < timer)
+	{
+		timer -= static_cast<u32>(span);
+		return 0;
+	}
+	span -= timer;
+	timer = period - static_cast<u32>(span % period);
+	return 1 + span / period;
+}
+
+static u8 TriangleLevel(u8 phase)
+{
+	return phase < 16 ? 15 - phase : phase - 16;
+}
+
+static u16 SweepTarget(u16 period, u8 shift, bool negate, bool onesComplement)
+{
+	const i32 change = period >> shift;
+	if (negate)
+	{
+		return static_cast<u16>(std::max(0, period - change - (onesComplement ? 1 : 0)));
+	}
+	return static_cast<u16>(period + change);
+}
+
+static bool SweepMutes(u16 period, u8 shift, bool negate, bool onesComplement)
+{
+	return period < 8 || SweepTarget(period, shift, negate, onesComplement) > 0x7FF;
+}
+
+void APU::Attach(CPU* cpu, CPUBus* bus)
+{
+	m_Cpu = cpu;
+	m_Bus = bus;
+	m_Pulses[0].onesComplement = true;
+}
+
+void APU::Reset()
+{
+	WriteRegister(0x4015, 0);
+	m_FrameIrq = false;
+	UpdateIrqLine();
+	WriteRegister(0x4017, m_FrameCounterControl);
+}
+
+void APU::CatchUp(u64 cycle)
+{
+	while (m_Cycle < cycle)
+	{
+		const std::span<const FrameStep> sequence = GetFrameSequence(m_FiveStepMode);
+		const u64 stepCycle = m_FrameCounterStart + sequence[m_FrameStep].cycle;
+		RunChannels(std::min({ cycle, stepCycle, m_FrameCounterReset }));
+
+		if (m_Cycle == stepCycle)
+		{
+			const u8 actions = sequence[m_FrameStep].actions;
+			if (actions & QUARTER_FRAME)
+			{
+				ClockQuarterFrame();
+			}
+			if (actions & HALF_FRAME)
+			{
+				ClockHalfFrame();
+			}
+			if ((actions & FRAME_IRQ) && !m_FrameIrqInhibit)
+			{
+				m_FrameIrq = true;
+				UpdateIrqLine();
+			}
+
+			if (++m_FrameStep == sequence.size())
+			{
+				m_FrameStep = 0;
+				m_FrameCounterStart += m_FiveStepMode ? FIVE_STEP_LENGTH : FOUR_STEP_LENGTH;
+			}
+		}
+		if (m_Cycle == m_FrameCounterReset)
+		{
+			m_FrameCounterReset = NO_EVENT;
+			ResetFrameCounter();
+		}
+	}
+	UpdateNextEventCycle();
+}
+
+void APU::SyncToCpu()
+{
+	const u64 cycle = m_Cpu->GetCycle();
+	if (cycle > 0)
+	{
+		CatchUp(cycle - 1);
+	}
+}
+
+void APU::RunChannels(u64 end)
+{
+	RunPulse(m_Pulses[0], end);
+	RunPulse(m_Pulses[1], end);
+	RunTriangle(end);
+	RunNoise(end);
+	RunDmc(end);
+	m_Cycle = end;
+}
+
+void APU::RunPulse(Pulse& pulse, u64 end)
+{
+	const u32 period = (pulse.period + 1u) * 2u;
+	const i32 volume = EnvelopeVolume(pulse.envelope) * PULSE_UNITS;
+
+	// Nothing but the phase changes while the output is flat
+	if (!m_Synthesize || volume == 0 || PulseMuted(pulse))
+	{
+		if (m_Synthesize)
+		{
+			Output(pulse.amp, 0, m_Cycle);
+		}
+		const u64 steps = AdvanceTimer(pulse.timer, period, end - m_Cycle);
+		pulse.phase = static_cast<u8>((pulse.phase + steps) & 7);
+		return;
+	}
+
+	u64 cycle = m_Cycle;
+	Output(pulse.amp, PulseLevel(pulse) * volume, cycle);
+	while (end - cycle >= pulse.timer)
+	{
+		cycle += pulse.timer;
+		pulse.timer = period;
+		pulse.phase = (pulse.phase + 1) & 7;
+		Output(pulse.amp, PulseLevel(pulse) * volume, cycle);
+	}
+	pulse.timer -= static_cast<u32>(end - cycle);
+}
+
+void APU::RunTriangle(u64 end)
+{
+	Triangle& triangle = m_Triangle;
+	const u32 period = triangle.period + 1u;
+	const bool stepping = triangle.length > 0 && triangle.linear > 0;
+	// Below a period of 2 the triangle is ultrasonic; holding the output
+	// there avoids the aliasing the console's own filters hide
+	const bool ultrasonic = triangle.period < 2;
+
+	if (!m_Synthesize || !stepping || ultrasonic)
+	{
+		if (m_Synthesize)
+		{
+			Output(triangle.amp, TriangleLevel(triangle.phase) * TRIANGLE_UNITS, m_Cycle);
+		}
+		const u64 steps = AdvanceTimer(triangle.timer, period, end - m_Cycle);
+		if (stepping)
+		{
+			triangle.phase = static_cast<u8>((triangle.phase + steps) & 31);
+		}
+		return;
+	}
+
+	u64 cycle = m_Cycle;
+	Output(triangle.amp, TriangleLevel(triangle.phase) * TRIANGLE_UNITS, cycle);
+	while (end - cycle >= triangle.timer)
+	{
+		cycle += triangle.timer;
+		triangle.timer = period;
+		triangle.phase = (triangle.phase + 1) & 31;
+		Output(triangle.amp, TriangleLevel(triangle.phase) * TRIANGLE_UNITS, cycle);
+	}
+	triangle.timer -= static_cast<u32>(end - cycle);
+}
+
+void APU::RunNoise(u64 end)
+{
+	Noise& noise = m_Noise;
+	const u32 period = NOISE_PERIODS[noise.periodIndex];
+	const u32 tap = noise.mode ? 6 : 1;
+	const bool audible = m_Synthesize && noise.length > 0 && EnvelopeVolume(noise.envelope) > 0;
+
+	// The shift register is part of the state, so it steps even when silent
+	u64 cycle = m_Cycle;
+	if (m_Synthesize)
+	{
+		Output(noise.amp, NoiseLevel(), cycle);
+	}
+	while (end - cycle >= noise.timer)
+	{
+		cycle += noise.timer;
+		noise.timer = period;
+		const u16 feedback = (noise.lfsr ^ (noise.lfsr >> tap)) & 1;
+		noise.lfsr = static_cast<u16>((noise.lfsr >> 1) | (feedback << 14));
+		if (audible)
+		{
+			Output(noise.amp, NoiseLevel(), cycle);
+		}
+	}
+	noise.timer -= static_cast<u32>(end - cycle);
+}
+
+void APU::RunDmc(u64 end)
+{
+	const u32 rate = DMC_RATES[m_Dmc.rateIndex];
+
+	u64 cycle = m_Cycle;
+	if (m_Synthesize)
+	{
+		Output(m_Dmc.amp, m_Dmc.level * DMC_UNITS, cycle);
+	}
+	while (end - cycle >= m_Dmc.timer)
+	{
+		cycle += m_Dmc.timer;
+		m_Dmc.timer = rate;
+		ClockDmcOutput();
+		if (m_Synthesize)
+		{
+			Output(m_Dmc.amp, m_Dmc.level * DMC_UNITS, cycle);
+		}
+	}
+	m_Dmc.timer -= static_cast<u32>(end - cycle);
+}
+
+void APU::ClockQuarterFrame()
+{
+	ClockEnvelope(m_Pulses[0].envelope);
+	ClockEnvelope(m_Pulses[1].envelope);
+	ClockEnvelope(m_Noise.envelope);
+
+	if (m_Triangle.linearReloadFlag)
+	{
+		m_Triangle.linear = m_Triangle.linearReload;
+	}
+	else if (m_Triangle.linear > 0)
+	{
+		m_Triangle.linear--;
+	}
+	if (!m_Triangle.control)
+	{
+		m_Triangle.linearReloadFlag = false;
+	}
+}
+
+void APU::ClockHalfFrame()
+{
+	for (Pulse& pulse : m_Pulses)
+	{
+		if (!pulse.envelope.loop && pulse.length > 0)
+		{
+			pulse.length--;
+		}
+		ClockSweep(pulse);
+	}
+	if (!m_Triangle.control && m_Triangle.length > 0)
+	{
+		m_Triangle.length--;
+	}
+	if (!m_Noise.envelope.loop && m_Noise.length > 0)
+	{
+		m_Noise.length--;
+	}
+}
+
+void APU::ClockEnvelope(Envelope& envelope)
+{
+	if (envelope.start)
+	{
+		envelope.start = false;
+		envelope.decay = 15;
+		envelope.divider = envelope.volume;
+	}
+	else if (envelope.divider == 0)
+	{
+		envelope.divider = envelope.volume;
+		if (envelope.decay > 0)
+		{
+			envelope.decay--;
+		}
+		else if (envelope.loop)
+		{
+			envelope.decay = 15;
+		}
+	}
+	else
+	{
+		envelope.divider--;
+	}
+}
+
+void APU::ClockSweep(Pulse& pulse)
+{
+	if (pulse.sweepDivider == 0 && pulse.sweepEnabled && pulse.sweepShift > 0 &&
+		!SweepMutes(pulse.period, pulse.sweepShift, pulse.sweepNegate, pulse.onesComplement))
+	{
+		pulse.period = SweepTarget(pulse.period, pulse.sweepShift, pulse.sweepNegate, pulse.onesComplement);
+	}
+	if (pulse.sweepDivider == 0 || pulse.sweepReload)
+	{
+		pulse.sweepDivider = pulse.sweepPeriod;
+		pulse.sweepReload = false;
+	}
+	else
+	{
+		pulse.sweepDivider--;
+	}
+}
+
+void APU::ResetFrameCounter()
+{
+	m_FiveStepMode = m_FrameCounterControl & 0x80;
+	m_FrameCounterStart = m_Cycle;
+	m_FrameStep = 0;
+	if (m_FiveStepMode)
+	{
+		ClockQuarterFrame();
+		ClockHalfFrame();
+	}
+}
+
+void APU::ClockDmcOutput()
+{
+	if (!m_Dmc.silence)
+	{
+		if (m_Dmc.shift & 1)
+		{
+			if (m_Dmc.level <= 125)
+			{
+				m_Dmc.level += 2;
+			}
+		}
+		else if (m_Dmc.level >= 2)
+		{
+			m_Dmc.level -= 2;
+		}
+	}
+	m_Dmc.shift >>= 1;
+
+	if (--m_Dmc.bitsRemaining == 0)
+	{
+		m_Dmc.bitsRemaining = 8;
+		m_Dmc.silence = !m_Dmc.bufferFull;
+		if (m_Dmc.bufferFull)
+		{
+			m_Dmc.shift = m_Dmc.buffer;
+			m_Dmc.bufferFull = false;
+			FetchDmcSample();
+		}
+	}
+}
+
+void APU::FetchDmcSample()
+{
+	if (m_Dmc.bufferFull || m_Dmc.bytesRemaining == 0)
+	{
+		return;
+	}
+
+	m_Dmc.buffer = m_Bus->ReadDmc(m_Dmc.addr);
+	m_Dmc.bufferFull = true;
+	m_Dmc.addr = m_Dmc.addr == 0xFFFF ? 0x8000 : m_Dmc.addr + 1;
+
+	if (--m_Dmc.bytesRemaining == 0)
+	{
+		if (m_Dmc.loop)
+		{
+			m_Dmc.addr = m_Dmc.sampleAddr;
+			m_Dmc.bytesRemaining = m_Dmc.sampleLength;
+		}
+		else if (m_Dmc.irqEnabled)
+		{
+			m_DmcIrq = true;
+			UpdateIrqLine();
+		}
+	}
+}
+
+void APU::UpdateIrqLine()
+{
+	m_Cpu->SetIRQLine(m_FrameIrq || m_DmcIrq);
+}
+
+void APU::UpdateNextEventCycle()
+{
+	// A pending $4017 write can start a sequence with an earlier IRQ
+	u64 next = m_FrameCounterReset;
+
+	if (!m_FiveStepMode && !m_FrameIrqInhibit && !m_FrameIrq)
+	{
+		u64 start = m_FrameCounterStart;
+		usize step = m_FrameStep;
+		while (!(FOUR_STEP_SEQUENCE[step].actions & FRAME_IRQ))
+		{
+			if (++step == FOUR_STEP_SEQUENCE.size())
+			{
+				step = 0;
+				start += FOUR_STEP_LENGTH;
+			}
+		}
+		next = std::min(next, start + FOUR_STEP_SEQUENCE[step].cycle);
+	}
+
+	// The buffer is always full while bytes remain, so the last byte is
+	// fetched when the output unit has shifted out every byte before it
+	if (m_Dmc.irqEnabled && !m_Dmc.loop && !m_DmcIrq && m_Dmc.bytesRemaining > 0)
+	{
+		const u64 rate = DMC_RATES[m_Dmc.rateIndex];
+		const u64 nextFetch = m_Cycle + m_Dmc.timer + (m_Dmc.bitsRemaining - 1) * rate;
+		next = std::min(next, nextFetch + (m_Dmc.bytesRemaining - 1) * 8 * rate);
+	}
+
+	m_NextEventCycle = next;
+}
+
+u8 APU::ReadStatus()
+{
+	SyncToCpu();
+
+	u8 status = 0;
+	status |= m_Pulses[0].length > 0 ? 0x01 : 0;
+	status |= m_Pulses[1].length > 0 ? 0x02 : 0;
+	status |= m_Triangle.length > 0 ? 0x04 : 0;
+	status |= m_Noise.length > 0 ? 0x08 : 0;
+	status |= m_Dmc.bytesRemaining > 0 ? 0x10 : 0;
+	status |= m_FrameIrq ? 0x40 : 0;
+	status |= m_DmcIrq ? 0x80 : 0;
+
+	m_FrameIrq = false;
+	UpdateIrqLine();
+	UpdateNextEventCycle();
+	return status;
+}
+
+void APU::WriteRegister(u16 addr, u8 val)
+{
+	SyncToCpu();
+
+	if (addr < 0x4008)
+	{
+		const u8 channel = (addr >> 2) & 1;
+		Pulse& pulse = m_Pulses[channel];
+		switch (addr & 0x3)
+		{
+		case 0:
+			pulse.duty = val >> 6;
+			pulse.envelope.loop = val & 0x20;
+			pulse.envelope.constant = val & 0x10;
+			pulse.envelope.volume = val & 0xF;
+			break;
+		case 1:
+			pulse.sweepEnabled = val & 0x80;
+			pulse.sweepPeriod = (val >> 4) & 0x7;
+			pulse.sweepNegate = val & 0x8;
+			pulse.sweepShift = val & 0x7;
+			pulse.sweepReload = true;
+			break;
+		case 2:
+			pulse.period = (pulse.period & 0x700) | val;
+			break;
+		case 3:
+			pulse.period = (pulse.period & 0xFF) | ((val & 0x7) << 8);
+			if (m_Enabled & (1 << channel))
+			{
+				pulse.length = LENGTH_TABLE[val >> 3];
+			}
+			pulse.phase = 0;
+			pulse.envelope.start = true;
+			break;
+		}
+		UpdateNextEventCycle();
+		return;
+	}
+
+	switch (addr)
+	{
+	case 0x4008:
+		m_Triangle.control = val & 0x80;
+		m_Triangle.linearReload = val & 0x7F;
+		break;
+	case 0x400A:
+		m_Triangle.period = (m_Triangle.period & 0x700) | val;
+		break;
+	case 0x400B:
+		m_Triangle.period = (m_Triangle.period & 0xFF) | ((val & 0x7) << 8);
+		if (m_Enabled & 0x04)
+		{
+			m_Triangle.length = LENGTH_TABLE[val >> 3];
+		}
+		m_Triangle.linearReloadFlag = true;
+		break;
+	case 0x400C:
+		m_Noise.envelope.loop = val & 0x20;
+		m_Noise.envelope.constant = val & 0x10;
+		m_Noise.envelope.volume = val & 0xF;
+		break;
+	case 0x400E:
+		m_Noise.mode = val & 0x80;
+		m_Noise.periodIndex = val & 0xF;
+		break;
+	case 0x400F:
+		if (m_Enabled & 0x08)
+		{
+			m_Noise.length = LENGTH_TABLE[val >> 3];
+		}
+		m_Noise.envelope.start = true;
+		break;
+	case 0x4010:
+		m_Dmc.irqEnabled = val & 0x80;
+		m_Dmc.loop = val & 0x40;
+		m_Dmc.rateIndex = val & 0xF;
+		if (!m_Dmc.irqEnabled)
+		{
+			m_DmcIrq = false;
+			UpdateIrqLine();
+		}
+		break;
+	case 0x4011:
+		m_Dmc.level = val & 0x7F;
+		break;
+	case 0x4012:
+		m_Dmc.sampleAddr = 0xC000 | (val << 6);
+		break;
+	case 0x4013:
+		m_Dmc.sampleLength = (val << 4) | 1;
+		break;
+	case 0x4015:
+		m_Enabled = val & 0x0F;
+		for (u8 channel = 0; channel < 2; channel++)
+		{
+			if (!(m_Enabled & (1 << channel)))
+			{
+				m_Pulses[channel].length = 0;
+			}
+		}
+		if (!(m_Enabled & 0x04))
+		{
+			m_Triangle.length = 0;
+		}
+		if (!(m_Enabled & 0x08))
+		{
+			m_Noise.length = 0;
+		}
+
+		m_DmcIrq = false;
+		if (!(val & 0x10))
+		{
+			m_Dmc.bytesRemaining = 0;
+		}
+		else if (m_Dmc.bytesRemaining == 0)
+		{
+			m_Dmc.addr = m_Dmc.sampleAddr;
+			m_Dmc.bytesRemaining = m_Dmc.sampleLength;
+			FetchDmcSample();
+		}
+		UpdateIrqLine();
+		break;
+	case 0x4017:
+		m_FrameCounterControl = val;
+		m_FrameIrqInhibit = val & 0x40;
+		if (m_FrameIrqInhibit)
+		{
+			m_FrameIrq = false;
+			UpdateIrqLine();
+		}
+		// 3 or 4 cycles on, depending on where the write lands in the
+		// APU's 2-cycle clock
+		m_FrameCounterReset = m_Cycle + ((m_Cycle & 1) ? 4 : 3);
+		break;
+	default:
+		break;
+	}
+	UpdateNextEventCycle();
+}
+
+void APU::SetSampleRate(u32 sampleRate)
+{
+	m_Buffer.Configure(CPU_CLOCK_RATE, sampleRate);
+	m_Synthesize = sampleRate != 0 && m_OutputEnabled;
+	ResetOutput();
+}
+
+void APU::SetOutputEnabled(bool enabled)
+{
+	if (enabled && !m_OutputEnabled)
+	{
+		// Picks up from the levels last put in the buffer
+		m_BlockCycle = m_Cycle;
+	}
+	m_OutputEnabled = enabled;
+	m_Synthesize = m_Buffer.GetSampleRate() != 0 && m_OutputEnabled;
+}
+
+void APU::EndFrame()
+{
+	CatchUp(m_Cpu->GetCycle());
+	if (m_Synthesize)
+	{
+		m_Buffer.EndBlock(static_cast<u32>(m_Cycle - m_BlockCycle));
+	}
+	m_BlockCycle = m_Cycle;
+}
+
+void APU::Output(i32& amp, i32 level, u64 cycle)
+{
+	if (level != amp)
+	{
+		m_Buffer.AddDelta(static_cast<u32>(cycle - m_BlockCycle), level - amp);
+		amp = level;
+	}
+}
+
+void APU::ResetOutput()
+{
+	m_Buffer.Clear();
+	m_BlockCycle = m_Cycle;
+	m_Pulses[0].amp = 0;
+	m_Pulses[1].amp = 0;
+	m_Triangle.amp = 0;
+	m_Noise.amp = 0;
+	m_Dmc.amp = 0;
+}
+
+u8 APU::PulseLevel(const Pulse& pulse)
+{
+	return (DUTY_SEQUENCES[pulse.duty] >> (7 - pulse.phase)) & 1;
+}
+
+bool APU::PulseMuted(const Pulse& pulse)
+{
+	return pulse.length == 0 || SweepMutes(pulse.period, pulse.sweepShift, pulse.sweepNegate, pulse.onesComplement);
+}
+
+i32 APU::NoiseLevel() const
+{
+	if (m_Noise.length == 0 || (m_Noise.lfsr & 1))
+	{
+		return 0;
+	}
+	return EnvelopeVolume(m_Noise.envelope) * NOISE_UNITS;
+}
+
+void APU::SerializeEnvelope(StateArchive& state, Envelope& envelope)
+{
+	state.Value(envelope.volume);
+	state.Value(envelope.divider);
+	state.Value(envelope.decay);
+	state.Value(envelope.constant);
+	state.Value(envelope.loop);
+	state.Value(envelope.start);
+}
+
+void APU::Serialize(StateArchive& state)
+{
+	// Sound made so far stays readable, the new state plays on from the
+	// levels already in the buffer
+	if (state.IsLoading() && m_Synthesize)
+	{
+		m_Buffer.EndBlock(static_cast<u32>(m_Cycle - m_BlockCycle));
+	}
+
+	for (Pulse& pulse : m_Pulses)
+	{
+		SerializeEnvelope(state, pulse.envelope);
+		state.Value(pulse.duty);
+		state.Value(pulse.phase);
+		state.Value(pulse.period);
+		state.Value(pulse.timer);
+		state.Value(pulse.length);
+		state.Value(pulse.sweepEnabled);
+		state.Value(pulse.sweepNegate);
+		state.Value(pulse.sweepReload);
+		state.Value(pulse.sweepPeriod);
+		state.Value(pulse.sweepShift);
+		state.Value(pulse.sweepDivider);
+	}
+
+	state.Value(m_Triangle.period);
+	state.Value(m_Triangle.timer);
+	state.Value(m_Triangle.phase);
+	state.Value(m_Triangle.length);
+	state.Value(m_Triangle.linear);
+	state.Value(m_Triangle.linearReload);
+	state.Value(m_Triangle.control);
+	state.Value(m_Triangle.linearReloadFlag);
+
+	SerializeEnvelope(state, m_Noise.envelope);
+	state.Value(m_Noise.periodIndex);
+	state.Value(m_Noise.mode);
+	state.Value(m_Noise.lfsr);
+	state.Value(m_Noise.timer);
+	state.Value(m_Noise.length);
+
+	state.Value(m_Dmc.irqEnabled);
+	state.Value(m_Dmc.loop);
+	state.Value(m_Dmc.rateIndex);
+	state.Value(m_Dmc.timer);
+	state.Value(m_Dmc.level);
+	state.Value(m_Dmc.sampleAddr);
+	state.Value(m_Dmc.sampleLength);
+	state.Value(m_Dmc.addr);
+	state.Value(m_Dmc.bytesRemaining);
+	state.Value(m_Dmc.buffer);
+	state.Value(m_Dmc.bufferFull);
+	state.Value(m_Dmc.shift);
+	state.Value(m_Dmc.bitsRemaining);
+	state.Value(m_Dmc.silence);
+
+	state.Value(m_Cycle);
+	state.Value(m_Enabled);
+	state.Value(m_FrameCounterControl);
+	state.Value(m_FiveStepMode);
+	state.Value(m_FrameIrqInhibit);
+	state.Value(m_FrameIrq);
+	state.Value(m_DmcIrq);
+	state.Value(m_FrameCounterStart);
+	state.Value(m_FrameStep);
+	state.Value(m_FrameCounterReset);
+
+	if (state.IsLoading())
+	{
+		m_BlockCycle = m_Cycle;
+		UpdateNextEventCycle();
+	}
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "../Core/Common.h"
+#include "BlipBuffer.h"
+
+#include <span>
+
+class CPU;
+class CPUBus;
+class StateArchive;
+
+// The 2A03's sound: two pulse channels, triangle, noise, DMC and the frame
+// counter. Nothing here runs per CPU cycle. The APU stands still until a
+// register access, one of its IRQs or the end of the frame needs it, then
+// catches up in one go, moving each channel from one timer expiry to the
+// next. Output level changes go into a band-limited step buffer as
+// deltas, so synthesis costs follow how often the waveforms change, not
+// the CPU clock or the sample rate.
+//
+// Channels are mixed with the linear approximation of the console's mixer.
+// DMC sample fetches don't stall the CPU.
+class APU
+{
+public:
+	// Mixer weight of one output step per channel, full scale being 1.0
+	// for the i16 samples
+	static constexpr double PULSE_WEIGHT = 0.00752;
+	static constexpr double TRIANGLE_WEIGHT = 0.00851;
+	static constexpr double NOISE_WEIGHT = 0.00494;
+	static constexpr double DMC_WEIGHT = 0.00335;
+
+	static constexpr u64 NO_EVENT = ~0ull;
+
+	void Attach(CPU* cpu, CPUBus* bus);
+
+	// The reset button: silences every channel and restarts the frame
+	// counter in its last mode
+	void Reset();
+
+	// Runs the APU forward until cycle CPU cycles have passed in total
+	void CatchUp(u64 cycle);
+
+	// Catches up to the start of the CPU cycle currently executing, as
+	// PPU::SyncToCpu
+	void SyncToCpu();
+
+	// CPU cycle at which the APU next raises an IRQ without a register
+	// access, NO_EVENT if none is coming
+	u64 GetNextEventCycle() const { return m_NextEventCycle; }
+
+	// $4015
+	u8 ReadStatus();
+
+	// $4000-$4013, $4015 and $4017
+	void WriteRegister(u16 addr, u8 val);
+
+	// Synthesizes sound at sampleRate from now on, 0 (the default) turns
+	// synthesis off. The channels still run for their IRQs and $4015.
+	void SetSampleRate(u32 sampleRate);
+
+	u32 GetSampleRate() const { return m_Buffer.GetSampleRate(); }
+
+	// Scales the sample rate by ratio from the start of the next frame,
+	// see BlipBuffer::SetRateRatio
+	void SetRateRatio(double ratio) { m_Buffer.SetRateRatio(ratio); }
+
+	// With output off no samples are made, for frames whose sound is
+	// never played. Time passed meanwhile doesn't appear in the output.
+	void SetOutputEnabled(bool enabled);
+
+	bool OutputEnabled() const { return m_OutputEnabled; }
+
+	// Catches up to the CPU and makes the samples up to here readable
+	void EndFrame();
+
+	usize GetSamplesAvailable() const { return m_Buffer.GetSamplesAvailable(); }
+
+	usize ReadSamples(std::span<i16> out) { return m_Buffer.ReadSamples(out); }
+
+	void Serialize(StateArchive& state);
+
+private:
+	struct Envelope
+	{
+		u8 volume = 0;
+		u8 divider = 0;
+		u8 decay = 0;
+		bool constant = false;
+		// Also halts the length counter
+		bool loop = false;
+		bool start = false;
+	};
+
+	struct Pulse
+	{
+		Envelope envelope{};
+		u8 duty = 0;
+		u8 phase = 0;
+		u16 period = 0;
+		// CPU cycles to the next sequencer step
+		u32 timer = 1;
+		u8 length = 0;
+		bool sweepEnabled = false;
+		bool sweepNegate = false;
+		bool sweepReload = false;
+		u8 sweepPeriod = 0;
+		u8 sweepShift = 0;
+		u8 sweepDivider = 0;
+		// Pulse 1 negates in one's complement
+		bool onesComplement = false;
+		// Level last put in the buffer, not part of the state
+		i32 amp = 0;
+	};
+
+	struct Triangle
+	{
+		u16 period = 0;
+		u32 timer = 1;
+		u8 phase = 0;
+		u8 length = 0;
+		u8 linear = 0;
+		u8 linearReload = 0;
+		bool control = false;
+		bool linearReloadFlag = false;
+		i32 amp = 0;
+	};
+
+	struct Noise
+	{
+		Envelope envelope{};
+		u8 periodIndex = 0;
+		bool mode = false;
+		u16 lfsr = 1;
+		u32 timer = 1;
+		u8 length = 0;
+		i32 amp = 0;
+	};
+
+	struct Dmc
+	{
+		bool irqEnabled = false;
+		bool loop = false;
+		u8 rateIndex = 0;
+		u32 timer = 1;
+		u8 level = 0;
+		u16 sampleAddr = 0xC000;
+		u16 sampleLength = 1;
+		u16 addr = 0xC000;
+		u16 bytesRemaining = 0;
+		u8 buffer = 0;
+		bool bufferFull = false;
+		u8 shift = 0;
+		u8 bitsRemaining = 8;
+		bool silence = true;
+		i32 amp = 0;
+	};
+
+	// Channels from m_Cycle to end, no frame counter step in between
+	void RunChannels(u64 end);
+
+	void RunPulse(Pulse& pulse, u64 end);
+	void RunTriangle(u64 end);
+	void RunNoise(u64 end);
+	void RunDmc(u64 end);
+
+	void ClockQuarterFrame();
+	void ClockHalfFrame();
+
+	static void ClockEnvelope(Envelope& envelope);
+	static void SerializeEnvelope(StateArchive& state, Envelope& envelope);
+	static void ClockSweep(Pulse& pulse);
+
+	// Restarts the frame counter sequence at m_Cycle, as a $4017 write does
+	// a few cycles later
+	void ResetFrameCounter();
+
+	void ClockDmcOutput();
+
+	// Refills the DMC sample buffer if it is empty and bytes are left
+	void FetchDmcSample();
+
+	void UpdateIrqLine();
+
+	void UpdateNextEventCycle();
+
+	// Sends channel level changes to the buffer at cycle
+	void Output(i32& amp, i32 level, u64 cycle);
+
+	// Restarts the output at m_Cycle from silence
+	void ResetOutput();
+
+	static u8 PulseLevel(const Pulse& pulse);
+	static bool PulseMuted(const Pulse& pulse);
+
+	i32 NoiseLevel() const;
+
+	static u8 EnvelopeVolume(const Envelope& envelope)
+	{
+		return envelope.constant ? envelope.volume : envelope.decay;
+	}
+
+private:
+	CPU* m_Cpu = nullptr;
+	CPUBus* m_Bus = nullptr;
+
+	Array<Pulse, 2> m_Pulses{};
+	Triangle m_Triangle{};
+	Noise m_Noise{};
+	Dmc m_Dmc{};
+
+	// CPU cycles the APU has run in total
+	u64 m_Cycle = 0;
+	// $4015 length counter enables, bits 0-3
+	u8 m_Enabled = 0;
+	// Last $4017 write
+	u8 m_FrameCounterControl = 0;
+
+	bool m_FiveStepMode = false;
+	bool m_FrameIrqInhibit = false;
+	bool m_FrameIrq = false;
+	bool m_DmcIrq = false;
+	// Cycle the current frame counter sequence started at
+	u64 m_FrameCounterStart = 0;
+	u8 m_FrameStep = 0;
+	// Cycle a pending $4017 write restarts the sequence, NO_EVENT if none
+	u64 m_FrameCounterReset = NO_EVENT;
+
+	u64 m_NextEventCycle = NO_EVENT;
+
+	// Output, not part of the state
+	BlipBuffer m_Buffer{};
+	bool m_OutputEnabled = true;
+	// Sends deltas to m_Buffer, only with a sample rate and output enabled
+	bool m_Synthesize = false;
+	// Cycle the buffer's current block started at
+	u64 m_BlockCycle = 0;
+};
@@ -0,0 +1,150 @@
+#include "BlipBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+// High-pass leak per sample, 1 / (1 << BASS_SHIFT): about 15 Hz at 48 kHz
+static constexpr u32 BASS_SHIFT = 9;
+// Passband edge as a fraction of the output Nyquist frequency
+static constexpr double KERNEL_CUTOFF = 0.9;
+
+using Kernel = Array<i16, BlipBuffer::KERNEL_WIDTH>;
+
+// Blackman-windowed sinc impulse for every sub-sample phase, each rounded
+// to sum exactly to 1 << DELTA_BITS so a step keeps its size
+static Array<Kernel, BlipBuffer::PHASE_COUNT> MakeKernels()
+{
+	constexpr double HALF_WIDTH = BlipBuffer::KERNEL_WIDTH / 2;
+	constexpr double PI = std::numbers::pi;
+
+	Array<Kernel, BlipBuffer::PHASE_COUNT> kernels{};
+	for (u32 phase = 0; phase < BlipBuffer::PHASE_COUNT; phase++)
+	{
+		Array<double, BlipBuffer::KERNEL_WIDTH> taps{};
+		double sum = 0.0;
+		for (u32 tap = 0; tap < BlipBuffer::KERNEL_WIDTH; tap++)
+		{
+			// Centred between the middle taps, so every phase fits the window
+			const double x = tap - (HALF_WIDTH - 1.0) - static_cast<double>(phase) / BlipBuffer::PHASE_COUNT;
+			const double y = KERNEL_CUTOFF * x;
+			const double sinc = y == 0.0 ? 1.0 : std::sin(PI * y) / (PI * y);
+			const double window = 0.42 + 0.5 * std::cos(PI * x / HALF_WIDTH) + 0.08 * std::cos(2.0 * PI * x / HALF_WIDTH);
+			taps[tap] = sinc * window;
+			sum += taps[tap];
+		}
+
+		Kernel& kernel = kernels[phase];
+		i32 rounded = 0;
+		usize peak = 0;
+		for (u32 tap = 0; tap < BlipBuffer::KERNEL_WIDTH; tap++)
+		{
+			kernel[tap] = static_cast<i16>(std::lround(taps[tap] / sum * (1 << BlipBuffer::DELTA_BITS)));
+			rounded += kernel[tap];
+			peak = kernel[tap] > kernel[peak] ? tap : peak;
+		}
+		kernel[peak] += static_cast<i16>((1 << BlipBuffer::DELTA_BITS) - rounded);
+	}
+	return kernels;
+}
+
+static const Array<Kernel, BlipBuffer::PHASE_COUNT> s_Kernels = MakeKernels();
+
+void BlipBuffer::Configure(double clockRate, u32 sampleRate, double bufferSeconds)
+{
+	m_SampleRate = sampleRate;
+	m_ClockRate = clockRate;
+	SetRateRatio(1.0);
+	m_MaxAvailable = static_cast<usize>(sampleRate * bufferSeconds);
+
+	// Room for a whole block past the samples kept, plus the kernel tail
+	const usize blockSamples = sampleRate / 10;
+	m_Samples.assign(sampleRate ? m_MaxAvailable + blockSamples + KERNEL_WIDTH : 0, 0);
+	Clear();
+}
+
+void BlipBuffer::SetRateRatio(double ratio)
+{
+	if (!m_SampleRate)
+	{
+		m_Factor = 0;
+		return;
+	}
+	m_Factor = static_cast<u64>(std::llround(m_SampleRate * ratio / m_ClockRate * static_cast<double>(1ull << FRAC_BITS)));
+}
+
+void BlipBuffer::Clear()
+{
+	std::fill(m_Samples.begin(), m_Samples.end(), 0);
+	m_Offset = 0;
+	m_Available = 0;
+	m_Used = 0;
+	m_Integrator = 0;
+}
+
+void BlipBuffer::AddDelta(u32 time, i32 delta)
+{
+	const u64 position = m_Offset + time * m_Factor;
+	const usize index = static_cast<usize>(position >> FRAC_BITS);
+	if (index + KERNEL_WIDTH > m_Samples.size())
+	{
+		// Only a block longer than allowed gets here
+		return;
+	}
+
+	const Kernel& kernel = s_Kernels[(position >> (FRAC_BITS - PHASE_BITS)) & (PHASE_COUNT - 1)];
+	i32* out = m_Samples.data() + index;
+	for (u32 tap = 0; tap < KERNEL_WIDTH; tap++)
+	{
+		out[tap] += kernel[tap] * delta;
+	}
+	m_Used = std::max(m_Used, index + KERNEL_WIDTH);
+}
+
+void BlipBuffer::EndBlock(u32 time)
+{
+	if (!m_SampleRate)
+	{
+		return;
+	}
+	m_Offset += time * m_Factor;
+	m_Available = static_cast<usize>(m_Offset >> FRAC_BITS);
+
+	if (m_Available > m_MaxAvailable)
+	{
+		Integrate(nullptr, m_Available - m_MaxAvailable);
+	}
+}
+
+usize BlipBuffer::ReadSamples(std::span<i16> out)
+{
+	const usize count = std::min(out.size(), m_Available);
+	Integrate(out.data(), count);
+	return count;
+}
+
+void BlipBuffer::Integrate(i16* out, usize count)
+{
+	i32 integrator = m_Integrator;
+	for (usize i = 0; i < count; i++)
+	{
+		const i32 sample = integrator >> DELTA_BITS;
+		integrator += m_Samples[i];
+		if (out)
+		{
+			out[i] = static_cast<i16>(std::clamp(sample, -32768, 32767));
+		}
+		integrator -= sample << (DELTA_BITS - BASS_SHIFT);
+	}
+	m_Integrator = integrator;
+
+	// Move the rest, including the steps already added past the end of the
+	// block, to the front
+	const usize remaining = m_Used > count ? m_Used - count : 0;
+	std::memmove(m_Samples.data(), m_Samples.data() + count, remaining * sizeof(i32));
+	std::fill(m_Samples.begin() + remaining, m_Samples.begin() + std::max(m_Used, remaining), 0);
+	m_Used = remaining;
+	m_Offset -= static_cast<u64>(count) << FRAC_BITS;
+	m_Available -= count;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <span>
+#include <vector>
+
+// Turns a signal described only by its steps into samples. Each AddDelta
+// is a step of the given size at a time in source clocks; it is spread
+// over KERNEL_WIDTH samples as a windowed sinc impulse picked from
+// PHASE_COUNT sub-sample offsets, and reading integrates the impulses
+// back into a band-limited waveform. The cost follows the number of steps
+// rather than the source clock rate. A slight high-pass when reading
+// removes the DC offset, as the console's own output filter does.
+class BlipBuffer
+{
+public:
+	static constexpr u32 KERNEL_WIDTH = 16;
+	static constexpr u32 PHASE_BITS = 5;
+	static constexpr u32 PHASE_COUNT = 1 << PHASE_BITS;
+	// Each kernel sums to 1 << DELTA_BITS
+	static constexpr u32 DELTA_BITS = 14;
+
+	// sampleRate 0 turns the buffer off. Unread samples beyond
+	// bufferSeconds are dropped, oldest first.
+	void Configure(double clockRate, u32 sampleRate, double bufferSeconds = 0.25);
+
+	u32 GetSampleRate() const { return m_SampleRate; }
+
+	// Makes ratio times as many samples per clock as configured from the
+	// next step on, without starting over. Meant for small adjustments
+	// such as dynamic rate control; Configure goes back to 1.
+	void SetRateRatio(double ratio);
+
+	// Drops all samples and steps and goes back to silence
+	void Clear();
+
+	// Step of delta at time clocks after the start of the current block
+	void AddDelta(u32 time, i32 delta);
+
+	// Makes every sample before time readable and starts the next block
+	// there. Blocks must be shorter than a tenth of a second.
+	void EndBlock(u32 time);
+
+	usize GetSamplesAvailable() const { return m_Available; }
+
+	// Reads up to out.size() mono samples, returns how many
+	usize ReadSamples(std::span<i16> out);
+
+private:
+	// Integrates count samples into out, which may be null to drop them
+	void Integrate(i16* out, usize count);
+
+private:
+	static constexpr u32 FRAC_BITS = 32;
+
+	u32 m_SampleRate = 0;
+	double m_ClockRate = 0.0;
+	// Samples per clock, FRAC_BITS fixed point
+	u64 m_Factor = 0;
+	// Position of the current block's start, FRAC_BITS fixed point
+	u64 m_Offset = 0;
+	usize m_Available = 0;
+	usize m_MaxAvailable = 0;
+	// Entries past this are all 0
+	usize m_Used = 0;
+	i32 m_Integrator = 0;
+	std::vector<i32> m_Samples{};
+};
@@ -2,8 +2,14 @@
 
 #include "CPUBus.h"
 #include "DebugUtils.h"
+#include "SaveState.h"
 
-const Array<Instruction, 256> CPU::s_OpcodeLookup = [] {
+// For static_assert in the last branch of an if constexpr chain, which
+// only fires if the branch is instantiated
+template <auto>
+inline constexpr bool DEPENDENT_FALSE = false;
+
+constexpr Array<Instruction, 256> CPU::s_OpcodeLookup = [] {
 	Array<Instruction, 256> lookup{};
 
 	lookup[0x69] = { Op::ADC, InstrType::Immediate };
@@ -379,19 +385,114 @@ void CPU::PerformCycle()
 	{
 		m_InstrDone = false;
 		m_InstrCycle = 0;
-		m_CurInterrupt = InterruptType::None;
-		if (m_IRQPending)
-		{
-			m_CurInterrupt = InterruptType::IRQ;
-		}
-		if (m_NMIPending)
-		{
-			m_CurInterrupt = InterruptType::NMI;
-			m_NMIPending = false;
-		}
+		// Dead once the instruction is over, and ExecuteInstruction never
+		// writes it. Cleared so the execution modes keep identical state.
+		m_ReadBuf.fill(0);
+		FinishInstruction();
+	}
+
+	PollInterrupts();
+}
+
+u32 CPU::ExecuteInstruction()
+{
+	ASSERT(AtInstructionBoundary());
+	const u64 startCycle = m_TotalCycles;
+
+	// Cycle 1, no interrupt poll after the fetch
+	m_TotalCycles++;
+	if (m_CurInterrupt == InterruptType::None)
+	{
+		const u8 opcode = Read(m_PC++);
+		m_TotalCycles++;
+		(this->*s_OpcodeHandlers[opcode])();
+	}
+	else
+	{
+		m_TotalCycles++;
+		ExecInterrupt();
 	}
 
+	FinishInstruction();
 	PollInterrupts();
+
+	return static_cast<u32>(m_TotalCycles - startCycle);
+}
+
+template <u8 OPCODE>
+void CPU::ExecOpcode()
+{
+	// Illegal ops are treated as NOP for now, same as PerformCycle
+	constexpr Instruction instr = s_OpcodeLookup[OPCODE].op == Op::None ? s_OpcodeLookup[0xEA] : s_OpcodeLookup[OPCODE];
+	constexpr Op OP = instr.op;
+	constexpr InstrType TYPE = instr.type;
+
+	if constexpr (TYPE == InstrType::Interrupt)
+	{
+		m_CurInterrupt = InterruptType::BRK;
+		ExecInterrupt();
+	}
+	else if constexpr (TYPE == InstrType::RTI) ExecRTI();
+	else if constexpr (TYPE == InstrType::RTS) ExecRTS();
+	else if constexpr (TYPE == InstrType::PHA) ExecPHA();
+	else if constexpr (TYPE == InstrType::PHP) ExecPHP();
+	else if constexpr (TYPE == InstrType::PLA) ExecPLA();
+	else if constexpr (TYPE == InstrType::PLP) ExecPLP();
+	else if constexpr (TYPE == InstrType::JSR) ExecJSR();
+	else if constexpr (TYPE == InstrType::Accumulator) ExecAccumulator<OP>();
+	else if constexpr (TYPE == InstrType::Implied) ExecImplied<OP>();
+	else if constexpr (TYPE == InstrType::Immediate) ExecImmediate<OP>();
+	else if constexpr (TYPE == InstrType::AbsoluteJMP) ExecAbsoluteJMP();
+	else if constexpr (TYPE == InstrType::AbsoluteRead) ExecAbsoluteRead<OP>();
+	else if constexpr (TYPE == InstrType::AbsoluteReadModifyWrite) ExecAbsoluteReadModifyWrite<OP>();
+	else if constexpr (TYPE == InstrType::AbsoluteWrite) ExecAbsoluteWrite<OP>();
+	else if constexpr (TYPE == InstrType::ZeroPageRead) ExecZeroPageRead<OP>();
+	else if constexpr (TYPE == InstrType::ZeroPageReadModifyWrite) ExecZeroPageReadModifyWrite<OP>();
+	else if constexpr (TYPE == InstrType::ZeroPageWrite) ExecZeroPageWrite<OP>();
+	else if constexpr (TYPE == InstrType::ZeroPageXRead) ExecZeroPageIndexedRead<OP, IndexType::X>();
+	else if constexpr (TYPE == InstrType::ZeroPageYRead) ExecZeroPageIndexedRead<OP, IndexType::Y>();
+	else if constexpr (TYPE == InstrType::ZeroPageXReadModifyWrite) ExecZeroPageXReadModifyWrite<OP>();
+	else if constexpr (TYPE == InstrType::ZeroPageXWrite) ExecZeroPageIndexedWrite<OP, IndexType::X>();
+	else if constexpr (TYPE == InstrType::ZeroPageYWrite) ExecZeroPageIndexedWrite<OP, IndexType::Y>();
+	else if constexpr (TYPE == InstrType::AbsoluteXRead) ExecAbsoluteIndexedRead<OP, IndexType::X>();
+	else if constexpr (TYPE == InstrType::AbsoluteYRead) ExecAbsoluteIndexedRead<OP, IndexType::Y>();
+	else if constexpr (TYPE == InstrType::AbsoluteXReadModifyWrite) ExecAbsoluteIndexedReadModifyWrite<OP, IndexType::X>();
+	else if constexpr (TYPE == InstrType::AbsoluteYReadModifyWrite) ExecAbsoluteIndexedReadModifyWrite<OP, IndexType::Y>();
+	else if constexpr (TYPE == InstrType::AbsoluteXWrite) ExecAbsoluteIndexedWrite<OP, IndexType::X>();
+	else if constexpr (TYPE == InstrType::AbsoluteYWrite) ExecAbsoluteIndexedWrite<OP, IndexType::Y>();
+	else if constexpr (TYPE == InstrType::Relative) ExecRelative<OP>();
+	else if constexpr (TYPE == InstrType::IndexedIndirectRead) ExecIndexedIndirectRead<OP>();
+	else if constexpr (TYPE == InstrType::IndexedIndirectReadModifyWrite) ExecIndexedIndirectReadModifyWrite<OP>();
+	else if constexpr (TYPE == InstrType::IndexedIndirectWrite) ExecIndexedIndirectWrite<OP>();
+	else if constexpr (TYPE == InstrType::IndirectIndexedRead) ExecIndirectIndexedRead<OP>();
+	else if constexpr (TYPE == InstrType::IndirectIndexedReadModifyWrite) ExecIndirectIndexedReadModifyWrite<OP>();
+	else if constexpr (TYPE == InstrType::IndirectIndexedWrite) ExecIndirectIndexedWrite<OP>();
+	else if constexpr (TYPE == InstrType::AbsoluteIndirect) ExecAbsoluteIndirect();
+	else static_assert(DEPENDENT_FALSE<TYPE>, "Unhandled instruction type");
+}
+
+constexpr Array<CPU::Handler, 256> CPU::s_OpcodeHandlers = MakeOpcodeHandlers(std::make_index_sequence<256>{});
+constexpr Array<CPU::Handler, CPU::OP_COUNT> CPU::s_OpHandlers = MakeOpHandlers(std::make_index_sequence<OP_COUNT>{});
+
+void CPU::Tick()
+{
+	PollInterrupts();
+	m_TotalCycles++;
+}
+
+// Interrupts are decided on what was polled before the last cycle
+void CPU::FinishInstruction()
+{
+	m_CurInterrupt = InterruptType::None;
+	if (m_IRQPending)
+	{
+		m_CurInterrupt = InterruptType::IRQ;
+	}
+	if (m_NMIPending)
+	{
+		m_CurInterrupt = InterruptType::NMI;
+		m_NMIPending = false;
+	}
 }
 
 void CPU::PollInterrupts()
@@ -429,6 +530,34 @@ void CPU::Reset()
 	m_CurInterrupt = InterruptType::RES;
 }
 
+void CPU::Serialize(StateArchive& state)
+{
+	state.Value(m_CurInstr);
+	state.Value(m_InstrCycle);
+	state.Value(m_A);
+	state.Value(m_X);
+	state.Value(m_Y);
+	state.Value(m_PC);
+	state.Value(m_S);
+	state.Value(m_P);
+	state.Value(m_Addr);
+	state.Value(m_Val);
+	state.Value(m_Carry);
+	state.Value(m_BranchTaken);
+	state.Value(m_InstrDone);
+	state.Value(m_NMILinePrev);
+	state.Value(m_NMILine);
+	state.Value(m_IRQLine);
+	state.Value(m_NMIPending);
+	state.Value(m_IRQPending);
+	state.Value(m_CurInterrupt);
+	state.Value(m_DMAIndex);
+	state.Value(m_DMAPage);
+	state.Value(m_DMAStatus);
+	state.Value(m_ReadBuf);
+	state.Value(m_TotalCycles);
+}
+
 void CPU::SetNMILine(bool asserted)
 {
 	m_NMILine = asserted;
@@ -537,6 +666,9 @@ void CPU::Interrupt()
 			Write(m_S + STACK_BEGIN, pushed);
 		}
 		m_S--;
+		// Masks IRQs in the handler, the level-triggered line would
+		// interrupt it straight away otherwise
+		m_P |= STATUS_INTERRUPT_DISABLE;
 		break;
 	case 6: 
 		m_ReadBuf[0] = Read(InterruptVectorLoc(m_CurInterrupt)); 
@@ -988,6 +1120,450 @@ void CPU::AbsoluteIndirect()
 	}
 }
 
+void CPU::ExecInterrupt()
+{
+	const bool reset = m_CurInterrupt == InterruptType::RES;
+
+	Read(m_PC);
+	if (m_CurInterrupt == InterruptType::BRK)
+		m_PC++;
+
+	// writes disabled for reset
+	Tick();
+	if (!reset)
+		Write(m_S + STACK_BEGIN, m_PC >> 8);
+	m_S--;
+
+	Tick();
+	if (!reset)
+		Write(m_S + STACK_BEGIN, m_PC & 0xFF);
+	m_S--;
+
+	Tick();
+	if (!reset)
+	{
+		const u8 pushed = m_CurInterrupt == InterruptType::BRK ? m_P | STATUS_BREAK : m_P;
+		Write(m_S + STACK_BEGIN, pushed);
+	}
+	m_S--;
+	m_P |= STATUS_INTERRUPT_DISABLE;
+
+	const u16 vector = InterruptVectorLoc(m_CurInterrupt);
+	Tick();
+	const u8 low = Read(vector);
+	Tick();
+	m_PC = (Read(vector + 1) << 8) | low;
+}
+
+void CPU::ExecRTI()
+{
+	Read(m_PC);
+	Tick();
+	m_S++;
+	Tick();
+	m_P = (ReadStack() & ~STATUS_BREAK) | STATUS_UNUSED;
+	m_S++;
+	Tick();
+	const u8 low = ReadStack();
+	m_S++;
+	Tick();
+	m_PC = (ReadStack() << 8) | low;
+}
+
+void CPU::ExecRTS()
+{
+	Read(m_PC);
+	Tick();
+	m_S++;
+	Tick();
+	const u8 low = ReadStack();
+	m_S++;
+	Tick();
+	m_PC = (ReadStack() << 8) | low;
+	Tick();
+	m_PC++;
+}
+
+void CPU::ExecPHA()
+{
+	Read(m_PC);
+	Tick();
+	PushStack(m_A);
+}
+
+void CPU::ExecPHP()
+{
+	Read(m_PC);
+	Tick();
+	PushStack(m_P | STATUS_BREAK);
+}
+
+void CPU::ExecPLA()
+{
+	Read(m_PC);
+	Tick();
+	m_S++;
+	Tick();
+	m_A = ReadStack();
+	SetZN(m_A);
+}
+
+void CPU::ExecPLP()
+{
+	Read(m_PC);
+	Tick();
+	m_S++;
+	Tick();
+	m_P = (ReadStack() & ~STATUS_BREAK) | STATUS_UNUSED;
+}
+
+void CPU::ExecJSR()
+{
+	const u8 low = Read(m_PC++);
+	Tick();
+	Tick();
+	PushStack(m_PC >> 8);
+	Tick();
+	PushStack(m_PC & 0xFF);
+	Tick();
+	m_PC = (Read(m_PC) << 8) | low;
+}
+
+template <Op OP>
+void CPU::ExecAccumulator()
+{
+	Read(m_PC);
+	m_Val = m_A;
+	ExecuteOp<OP>();
+	m_A = m_Val;
+}
+
+template <Op OP>
+void CPU::ExecImplied()
+{
+	Read(m_PC);
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecImmediate()
+{
+	m_Val = Read(m_PC++);
+	ExecuteOp<OP>();
+}
+
+void CPU::ExecAbsoluteJMP()
+{
+	const u8 low = Read(m_PC++);
+	Tick();
+	m_PC = (Read(m_PC) << 8) | low;
+}
+
+template <Op OP>
+void CPU::ExecAbsoluteRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Addr |= Read(m_PC++) << 8;
+	Tick();
+	m_Val = Read(m_Addr);
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecAbsoluteReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Addr |= Read(m_PC++) << 8;
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecAbsoluteWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Addr |= Read(m_PC++) << 8;
+	Tick();
+	ExecuteOp<OP>();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecZeroPageRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Val = Read(m_Addr);
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecZeroPageReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecZeroPageWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	ExecuteOp<OP>();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP, IndexType IT>
+void CPU::ExecZeroPageIndexedRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + (IT == IndexType::X ? m_X : m_Y)) & 0xFF;
+	Tick();
+	m_Val = Read(m_Addr);
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecZeroPageXReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + m_X) & 0xFF;
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP, IndexType IT>
+void CPU::ExecZeroPageIndexedWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + (IT == IndexType::X ? m_X : m_Y)) & 0xFF;
+	Tick();
+	ExecuteOp<OP>();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP, IndexType IT>
+void CPU::ExecAbsoluteIndexedRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u16 sumLow = m_Addr + (IT == IndexType::X ? m_X : m_Y);
+	m_Addr = (Read(m_PC++) << 8) | (sumLow & 0xFF);
+	Tick();
+	m_Val = Read(m_Addr);
+	// extra cycle to fix the high byte if a page was crossed
+	if (sumLow >> 8)
+	{
+		m_Addr += 0x100;
+		Tick();
+		m_Val = Read(m_Addr);
+	}
+	ExecuteOp<OP>();
+}
+
+template <Op OP, IndexType IT>
+void CPU::ExecAbsoluteIndexedReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u16 sumLow = m_Addr + (IT == IndexType::X ? m_X : m_Y);
+	m_Addr = (Read(m_PC++) << 8) | (sumLow & 0xFF);
+	Tick();
+	m_Val = Read(m_Addr);
+	m_Addr += sumLow & 0x100;
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP, IndexType IT>
+void CPU::ExecAbsoluteIndexedWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u16 sumLow = m_Addr + (IT == IndexType::X ? m_X : m_Y);
+	m_Addr = (Read(m_PC++) << 8) | (sumLow & 0xFF);
+	Tick();
+	m_Val = Read(m_Addr);
+	ExecuteOp<OP>();
+	m_Addr += sumLow & 0x100;
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecRelative()
+{
+	m_Val = Read(m_PC++);
+	ExecuteOp<OP>(); // will set m_BranchTaken
+	if (!m_BranchTaken)
+		return;
+
+	Tick();
+	Read(m_PC);
+	const i16 offset = static_cast<i8>(m_Val);
+	const u16 newPC = m_PC + offset;
+	if ((m_PC & 0xFF00) != (newPC & 0xFF00))
+	{
+		// read from wrong page first
+		Tick();
+		Read((m_PC & 0xFF00) | (newPC & 0xFF));
+	}
+	m_PC = newPC;
+}
+
+template <Op OP>
+void CPU::ExecIndexedIndirectRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + m_X) & 0xFF;
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | low;
+	Tick();
+	m_Val = Read(m_Addr);
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecIndexedIndirectReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + m_X) & 0xFF;
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | low;
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecIndexedIndirectWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	Read(m_Addr);
+	m_Addr = (m_Addr + m_X) & 0xFF;
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | low;
+	Tick();
+	ExecuteOp<OP>();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecIndirectIndexedRead()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	const u16 sumLow = low + m_Y;
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | (sumLow & 0xFF);
+	Tick();
+	m_Val = Read(m_Addr);
+	if (sumLow >> 8)
+	{
+		m_Addr += 0x100;
+		Tick();
+		m_Val = Read(m_Addr);
+	}
+	ExecuteOp<OP>();
+}
+
+template <Op OP>
+void CPU::ExecIndirectIndexedReadModifyWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	const u16 sumLow = low + m_Y;
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | (sumLow & 0xFF);
+	Tick();
+	m_Val = Read(m_Addr);
+	m_Addr += sumLow & 0x100;
+	Tick();
+	m_Val = Read(m_Addr);
+	Tick();
+	Write(m_Addr, m_Val);
+	ExecuteOp<OP>();
+	Tick();
+	Write(m_Addr, m_Val);
+}
+
+template <Op OP>
+void CPU::ExecIndirectIndexedWrite()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	const u16 sumLow = low + m_Y;
+	m_Addr = (Read((m_Addr + 1) & 0xFF) << 8) | (sumLow & 0xFF);
+	Tick();
+	Read(m_Addr);
+	m_Addr += sumLow & 0x100;
+	Tick();
+	ExecuteOp<OP>();
+	Write(m_Addr, m_Val);
+}
+
+void CPU::ExecAbsoluteIndirect()
+{
+	m_Addr = Read(m_PC++);
+	Tick();
+	m_Addr = (Read(m_PC++) << 8) | m_Addr;
+	Tick();
+	const u8 low = Read(m_Addr);
+	Tick();
+	// PC high fetched from same page as PC low
+	const u16 adjusted = (m_Addr & 0xFF00) | ((m_Addr + 1) & 0xFF);
+	m_PC = (Read(adjusted) << 8) | low;
+}
+
 void CPU::PushStack(u8 val)
 {
 	Write(m_S + STACK_BEGIN, val);
@@ -1031,12 +1607,18 @@ void CPU::SetZN(u8 val)
 	SetStatusBit(STATUS_NEGATIVE, val & 0x80);
 }
 
+void CPU::ExecuteOp()
+{
+	(this->*s_OpHandlers[static_cast<usize>(m_CurInstr.op)])();
+}
+
+template <Op OP>
 void CPU::ExecuteOp()
 {
 	u8 result, tmp;
 	u16 result16;
 	constexpr u8 CONST = 0xFF;
-	switch (m_CurInstr.op)
+	switch (OP)
 	{
 	case Op::ADC:
 		result16 = m_A + m_Val + (m_P & STATUS_CARRY ? 1 : 0);
@@ -2,6 +2,8 @@
 
 #include "../Core/Common.h"
 
+#include <utility>
+
 enum class IndexType { X, Y };
 
 class CPU;
@@ -79,10 +81,14 @@ struct Instruction
 };
 
 class CPUBus;
+class StateArchive;
 
 class CPU
 {
 public:
+	// Longest instruction (indexed indirect read-modify-write)
+	static constexpr u32 MAX_INSTRUCTION_CYCLES = 8;
+
 	CPU();
 	explicit CPU(CPUBus* bus);
 
@@ -90,6 +96,14 @@ public:
 
 	void PerformCycle();
 
+	// Runs the next instruction or interrupt sequence to completion and
+	// returns the cycles it took. Each bus access is still stamped with
+	// its own cycle, so GetCycle() during a Read/Write is the same as in
+	// PerformCycle. Only valid when AtInstructionBoundary() is true.
+	u32 ExecuteInstruction();
+
+	bool AtInstructionBoundary() const { return m_InstrCycle == 0 && m_DMAStatus == DMAStatus::Inactive; }
+
 	void Reset();
 
 	void SetNMILine(bool asserted);
@@ -98,6 +112,8 @@ public:
 
 	u64 GetCycle() const { return m_TotalCycles; }
 
+	void Serialize(StateArchive& state);
+
 private:
 	void PrintState();
 
@@ -105,6 +121,12 @@ private:
 
 	void PollInterrupts();
 
+	// Between two cycles of ExecuteInstruction: the interrupt poll that
+	// closes the previous cycle, then the new cycle's timestamp
+	void Tick();
+
+	void FinishInstruction();
+
 	void DMAStep();
 
 	u8 PopStack();
@@ -117,8 +139,11 @@ private:
 	void SetStatusBit(u8 mask, bool cond);
 	void SetZN(u8 val);
 
+	// Runtime dispatch on m_CurInstr.op, for the per-cycle functions
 	void ExecuteOp();
 
+	template <Op OP> void ExecuteOp();
+
 	// ------- Cycle functions -----------
 
 	void Interrupt();
@@ -152,11 +177,75 @@ private:
 
 	void AbsoluteIndirect();
 
+	// ------- Instruction functions ---------
+	// Same bus accesses as the cycle functions above, run straight through
+	// from cycle 2 to the last cycle. The operation is a template argument
+	// so each opcode gets its own copy with the ALU op inlined.
+
+	// Handler for one opcode, picked from s_OpcodeLookup at compile time
+	template <u8 OPCODE> void ExecOpcode();
+
+	void ExecInterrupt();
+
+	void ExecRTI(); void ExecRTS(); void ExecPHA(); void ExecPHP();
+	void ExecPLA(); void ExecPLP(); void ExecJSR();
+
+	template <Op OP> void ExecAccumulator();
+	template <Op OP> void ExecImplied();
+	template <Op OP> void ExecImmediate();
+
+	void ExecAbsoluteJMP();
+	template <Op OP> void ExecAbsoluteRead();
+	template <Op OP> void ExecAbsoluteReadModifyWrite();
+	template <Op OP> void ExecAbsoluteWrite();
+
+	template <Op OP> void ExecZeroPageRead();
+	template <Op OP> void ExecZeroPageReadModifyWrite();
+	template <Op OP> void ExecZeroPageWrite();
+
+	template <Op OP, IndexType IT> void ExecZeroPageIndexedRead();
+	template <Op OP> void ExecZeroPageXReadModifyWrite();
+	template <Op OP, IndexType IT> void ExecZeroPageIndexedWrite();
+
+	template <Op OP, IndexType IT> void ExecAbsoluteIndexedRead();
+	template <Op OP, IndexType IT> void ExecAbsoluteIndexedReadModifyWrite();
+	template <Op OP, IndexType IT> void ExecAbsoluteIndexedWrite();
+
+	template <Op OP> void ExecRelative();
+
+	template <Op OP> void ExecIndexedIndirectRead();
+	template <Op OP> void ExecIndexedIndirectReadModifyWrite();
+	template <Op OP> void ExecIndexedIndirectWrite();
+
+	template <Op OP> void ExecIndirectIndexedRead();
+	template <Op OP> void ExecIndirectIndexedReadModifyWrite();
+	template <Op OP> void ExecIndirectIndexedWrite();
+
+	void ExecAbsoluteIndirect();
+
 	// ---------------------------------------
 	
 
 private:
+	using Handler = void (CPU::*)();
+
+	static constexpr usize OP_COUNT = static_cast<usize>(Op::TAS) + 1;
+
+	template <usize... Opcodes>
+	static constexpr Array<Handler, sizeof...(Opcodes)> MakeOpcodeHandlers(std::index_sequence<Opcodes...>)
+	{
+		return { &CPU::ExecOpcode<static_cast<u8>(Opcodes)>... };
+	}
+
+	template <usize... Ops>
+	static constexpr Array<Handler, sizeof...(Ops)> MakeOpHandlers(std::index_sequence<Ops...>)
+	{
+		return { &CPU::ExecuteOp<static_cast<Op>(Ops)>... };
+	}
+
 	static const Array<Instruction, 256> s_OpcodeLookup;
+	static const Array<Handler, 256> s_OpcodeHandlers;
+	static const Array<Handler, OP_COUNT> s_OpHandlers;
 
 private:
 	CPUBus* m_Bus = nullptr;
@@ -1,8 +1,11 @@
 #include "CPUBus.h"
 
+#include "APU.h"
+#include "CowMemory.h"
 #include "Mapper.h"
 #include "PPU.h"
 #include "HardwareController.h"
+#include "SaveState.h"
 #include "../Core/Logger.h"
 
 enum IORegisters : u16
@@ -15,39 +18,62 @@ enum IORegisters : u16
 	PPUSCROLL,
 	PPUADDR,
 	PPUDATA,
+	DMC_LENGTH = 0x4013,
 	OAMDMA = 0x4014,
+	APU_STATUS = 0x4015,
 	JOY1 = 0x4016,
-	JOY2
+	JOY2,
+	FRAME_COUNTER = JOY2
 };
 
 
-CPUBus::CPUBus(Mapper* mapper, PPU* ppu, u8* ram, HardwareController* controller) : 
+CPUBus::CPUBus(Mapper* mapper, PPU* ppu, APU* apu, CowMemory* ram, HardwareController* controller) : 
 	m_Mapper{ mapper }, 
 	m_Ppu{ ppu }, 
+	m_Apu{ apu },
 	m_Ram{ram },
 	m_Controller{controller}
 {
 }
 
-void CPUBus::Attach(Mapper* mapper, PPU* ppu, u8* ram, HardwareController* controller)
+void CPUBus::Attach(Mapper* mapper, PPU* ppu, APU* apu, CowMemory* ram, HardwareController* controller)
 {
 	m_Mapper = mapper;
 	m_Ppu = ppu;
+	m_Apu = apu;
 	m_Ram = ram;
 	m_Controller = controller;
+
+	m_ReadPages.fill(nullptr);
+	m_WritePages.fill(nullptr);
+
+	MapRam();
+
+	m_Mapper->ConnectBus(this);
+}
+
+void CPUBus::MapRam()
+{
+	// 2KB internal RAM mirrored up to $2000
+	for (u16 addr = 0; addr < 0x2000; addr += PAGE_SIZE)
+	{
+		MapReadPage(addr, m_Ram->GetReadPtr(addr & 0x7FF));
+		MapWritePage(addr, m_Ram->GetWritePtr(addr & 0x7FF));
+	}
 }
 
 // TODO: check if switching on bits is faster than conditionals
-u8 CPUBus::Read(u16 addr)
+u8 CPUBus::ReadSlow(u16 addr)
 {
 	u8 read = m_OpenBus;
 
 	if (addr < 0x2000)
 	{
-		read = m_Ram[addr & 0x7FF];
+		read = m_Ram->Read(addr & 0x7FF);
 	}
 	else if (addr < 0x4000)
 	{
+		m_Ppu->SyncToCpu();
 		const u16 mirrored = 0x2000 | (addr & 0x7);
 		switch (mirrored)
 		{
@@ -69,9 +95,12 @@ u8 CPUBus::Read(u16 addr)
 	else if (addr < 0x4020)
 	{
 		// TODO: handle open bus for upper bits of controller
-		// Also add APU here
 		switch (addr)
 		{
+		case APU_STATUS:
+			// bit 5 is open bus
+			read = m_Apu->ReadStatus() | (m_OpenBus & 0b00100000);
+			break;
 		case JOY1:
 			// upper bits are open bus
 			read = (m_OpenBus & 0b11100000) | m_Controller->ReadBit();
@@ -93,17 +122,18 @@ u8 CPUBus::Read(u16 addr)
 	return read;
 }
 
-void CPUBus::Write(u16 addr, u8 val)
+void CPUBus::WriteSlow(u16 addr, u8 val)
 {
 	m_OpenBus = val;
 
 	if (addr < 0x2000)
 	{
-		m_Ram[addr & 0x7FF] = val;
+		m_Ram->Write(addr & 0x7FF, val);
 		return;
 	}
 	else if (addr < 0x4000)
 	{
+		m_Ppu->SyncToCpu();
 		const u16 mirrored = 0x2000 | (addr & 0x7);
 		switch (mirrored)
 		{
@@ -137,6 +167,11 @@ void CPUBus::Write(u16 addr, u8 val)
 	else if (addr < 0x4020)
 	{
 		// APU and I/O functionality, most are normally disabled
+		if (addr <= DMC_LENGTH || addr == APU_STATUS || addr == FRAME_COUNTER)
+		{
+			m_Apu->WriteRegister(addr, val);
+			return;
+		}
 		switch (addr)
 		{
 		case OAMDMA: 
@@ -162,6 +197,9 @@ void CPUBus::Write(u16 addr, u8 val)
 	}
 	else
 	{
+		// Bank switches change what the PPU and the DMC fetch from here on
+		m_Ppu->SyncToCpu();
+		m_Apu->SyncToCpu();
 		m_Mapper->CpuWrite(addr, val);
 		return;
 	}
@@ -169,7 +207,22 @@ void CPUBus::Write(u16 addr, u8 val)
 	LOG_VERBOSE("Invalid CPU write to %hx", addr);
 }
 
+u8 CPUBus::ReadDmc(u16 addr)
+{
+	if (const u8* page = m_ReadPages[addr >> PAGE_SHIFT])
+	{
+		return page[addr & PAGE_MASK];
+	}
+	return m_Mapper->CpuRead(addr).value_or(m_OpenBus);
+}
+
 void CPUBus::PPUDirectWrite(u8 val)
 {
+	m_Ppu->SyncToCpu();
 	m_Ppu->DirectOAMWrite(val);
 }
+
+void CPUBus::Serialize(StateArchive& state)
+{
+	state.Value(m_OpenBus);
+}
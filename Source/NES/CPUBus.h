@@ -2,29 +2,84 @@
 
 #include "../Core/Common.h"
 
+class APU;
+class CowMemory;
 class Mapper;
 class PPU;
 class HardwareController;
+class StateArchive;
 
 class CPUBus
 {
 public:
+	// The address space is split into 1KB pages. Pages backed by plain
+	// memory (RAM, PRG-ROM, PRG-RAM) get a direct pointer and are read or
+	// written with one indexed load; null pages go through the full
+	// address decode for I/O registers, mapper registers and open bus.
+	static constexpr u16 PAGE_SHIFT = 10;
+	static constexpr u16 PAGE_SIZE = 1 << PAGE_SHIFT;
+	static constexpr u16 PAGE_MASK = PAGE_SIZE - 1;
+	static constexpr usize PAGE_COUNT = 0x10000 >> PAGE_SHIFT;
+
 	CPUBus() = default;
 
-	CPUBus(Mapper* mapper, PPU* ppu, u8* ram, HardwareController* controller);
+	CPUBus(Mapper* mapper, PPU* ppu, APU* apu, CowMemory* ram, HardwareController* controller);
+
+	void Attach(Mapper* mapper, PPU* ppu, APU* apu, CowMemory* ram, HardwareController* controller);
+
+	// Points $0000-$1FFF at the internal RAM, again after its pages move
+	void MapRam();
+
+	u8 Read(u16 addr)
+	{
+		if (const u8* page = m_ReadPages[addr >> PAGE_SHIFT])
+		{
+			m_OpenBus = page[addr & PAGE_MASK];
+			return m_OpenBus;
+		}
+		return ReadSlow(addr);
+	}
+
+	void Write(u16 addr, u8 val)
+	{
+		if (u8* page = m_WritePages[addr >> PAGE_SHIFT])
+		{
+			m_OpenBus = val;
+			page[addr & PAGE_MASK] = val;
+			return;
+		}
+		WriteSlow(addr, val);
+	}
 
-	void Attach(Mapper* mapper, PPU* ppu, u8* ram, HardwareController* controller);
+	// Full address decode, bypassing the page table. Used for unmapped
+	// pages, and public so benchmarks can compare the two paths.
+	u8 ReadSlow(u16 addr);
 
-	u8 Read(u16 addr);
+	void WriteSlow(u16 addr, u8 val);
+
+	// DMC sample fetch. Doesn't drive the CPU's data bus, so open bus is
+	// left alone.
+	u8 ReadDmc(u16 addr);
 
-	void Write(u16 addr, u8 val);
-	
 	void PPUDirectWrite(u8 val);
 
+	// Points the page containing addr at data, or back to the slow path
+	// when data is nullptr. data must hold PAGE_SIZE bytes.
+	void MapReadPage(u16 addr, const u8* data) { m_ReadPages[addr >> PAGE_SHIFT] = data; }
+
+	void MapWritePage(u16 addr, u8* data) { m_WritePages[addr >> PAGE_SHIFT] = data; }
+
+	// Only the open bus value, the page table belongs to the mapper
+	void Serialize(StateArchive& state);
+
 private:
+	Array<const u8*, PAGE_COUNT> m_ReadPages{};
+	Array<u8*, PAGE_COUNT> m_WritePages{};
+
 	Mapper* m_Mapper = nullptr;
 	PPU* m_Ppu = nullptr;
-	u8* m_Ram = nullptr;
+	APU* m_Apu = nullptr;
+	CowMemory* m_Ram = nullptr;
 	HardwareController* m_Controller = nullptr;
 
 	u8 m_OpenBus = 0;
@@ -1,94 +1,57 @@
 #include "Cartridge.h"
+#include "SaveState.h"
+
+#include "../Core/Hash.h"
 
-#include <fstream>
 #include <cstring>
 
 CartridgeLoadResult Cartridge::LoadFromFile(const std::filesystem::path& path)
 {
-	std::ifstream inf{ path, std::ios::binary };
-
-	if (!inf)
+	std::shared_ptr<const RomImage> image;
+	const CartridgeLoadResult result = RomImage::LoadFromFile(path, image);
+	if (result == CartridgeLoadResult::Success)
 	{
-		return CartridgeLoadResult::FileNotFound;
+		Load(std::move(image));
 	}
+	return result;
+}
 
-	const char expectedHeader[4] = { 'N', 'E', 'S', '\x1A' };
-
-	u8 header[16];
-
-	inf.read(reinterpret_cast<char*>(header), 16);
-
-	if (inf.eof() || std::strncmp(reinterpret_cast<char*>(header), expectedHeader, 4) != 0)
-	{
-		return CartridgeLoadResult::InvalidHeader;
-	}
+void Cartridge::Load(std::shared_ptr<const RomImage> image)
+{
+	m_Image = std::move(image);
 
-	m_PrgRomSize = header[4] * 0x4000;
-	if (m_PrgRomSize == 0)
-	{
-		return CartridgeLoadResult::InvalidPrgRomSize;
-	}
-	m_PrgRom = std::make_unique<u8[]>(m_PrgRomSize);
+	m_PrgRom = m_Image->GetPrgRom();
+	m_PrgRomSize = m_Image->GetPrgRomSize();
+	m_ChrRom = m_Image->GetChrRom();
+	m_ChrSize = m_Image->GetChrSize();
+	m_PrgRamSize = m_Image->GetPrgRamSize();
+	m_MirrorMode = m_Image->GetMirrorMode();
+	m_MapperNumber = m_Image->GetMapperNumber();
 
-	m_ChrSize = header[5] * 0x2000;
-	if (m_ChrSize == 0)
+	if (m_ChrRom)
 	{
-		m_ChrSize = 0x2000;
-		m_ChrRam = std::make_unique<u8[]>(0x2000);
+		m_ChrRam.Release();
 	}
 	else
 	{
-		m_ChrRom = std::make_unique<u8[]>(m_ChrSize);
+		m_ChrRam.Allocate(m_ChrSize);
 	}
 
-	if (header[6] & (1 << 0))
+	if (m_Image->HasPrgRam())
 	{
-		m_MirrorMode = MirrorMode::Vertical;
+		m_PrgRam.Allocate(m_PrgRamSize);
 	}
 	else
 	{
-		m_MirrorMode = MirrorMode::Horizontal;
-	}
-
-	m_HasPrgRam = header[6] & (1 << 1);
-	m_HasTrainer = header[6] & (1 << 2);
-	if (header[6] & (1 << 3))
-	{
-		m_MirrorMode = MirrorMode::FourScreen;
-	}
-	m_MapperNumber = (header[6] >> 4) | (header[7] & 0xF0);
-
-	m_PrgRamSize = header[8] * 0x2000;
-	if (m_HasPrgRam && m_PrgRamSize == 0)
-	{
-		m_PrgRamSize = 0x8000u;
-	}
-	if (m_HasPrgRam)
-	{
-		m_PrgRam = std::make_unique<u8[]>(m_PrgRamSize);
-	}
-
-	if (m_HasTrainer)
-	{
-		m_Trainer = std::make_unique<u8[]>(0x200);
-		inf.read(reinterpret_cast<char*>(m_Trainer.get()), 0x200);
-		if (inf.eof())
-			return CartridgeLoadResult::MissingData;
+		m_PrgRam.Release();
 	}
 
-	inf.read(reinterpret_cast<char*>(m_PrgRom.get()), m_PrgRomSize);
-
-	if (m_ChrRom)
-	{
-		inf.read(reinterpret_cast<char*>(m_ChrRom.get()), m_ChrSize);
-	}
-
-	if (inf.eof())
+	m_Trainer = nullptr;
+	if (m_Image->GetTrainer())
 	{
-		return CartridgeLoadResult::MissingData;
+		m_Trainer = std::make_unique<u8[]>(RomImage::TRAINER_SIZE);
+		std::memcpy(m_Trainer.get(), m_Image->GetTrainer(), RomImage::TRAINER_SIZE);
 	}
-
-	return CartridgeLoadResult::Success;
 }
 
 u8 Cartridge::ReadPrgRom(usize offset) const
@@ -106,36 +69,68 @@ u8 Cartridge::ReadChr(usize offset) const
 	}
 	else
 	{
-		return m_ChrRam[offset];
+		return m_ChrRam.Read(offset);
 	}
 }
 
 std::optional<u8> Cartridge::ReadPrgRam(usize offset) const
 {
-	if (!m_PrgRam)
+	if (!HasPrgRam())
 	{
 		return std::nullopt;
 	}
 
-	return m_PrgRam[offset & (m_PrgRamSize - 1)];
+	return m_PrgRam.Read(offset & (m_PrgRamSize - 1));
 }
 
 void Cartridge::WritePrgRam(usize offset, u8 data)
 {
-	if (!m_PrgRam)
+	if (!HasPrgRam())
 	{
 		return;
 	}
 
-	m_PrgRam[offset & (m_PrgRamSize - 1)] = data;
+	m_PrgRam.Write(offset & (m_PrgRamSize - 1), data);
 }
 
 void Cartridge::WriteChr(usize offset, u8 data)
 {
 	offset &= m_ChrSize - 1;
 
-	if (m_ChrRam)
+	if (!m_ChrRom)
+	{
+		m_ChrRam.Write(offset, data);
+	}
+}
+
+void Cartridge::ShareRam(Cartridge& other)
+{
+	ASSERT(m_Image == other.m_Image);
+
+	if (other.HasPrgRam())
 	{
-		m_ChrRam[offset] = data;
+		m_PrgRam.ShareFrom(other.m_PrgRam);
 	}
+	if (!other.m_ChrRom)
+	{
+		m_ChrRam.ShareFrom(other.m_ChrRam);
+	}
+}
+
+void Cartridge::SetRemapHandler(const std::function<void()>& handler)
+{
+	m_PrgRam.SetRemapHandler(handler);
+	m_ChrRam.SetRemapHandler(handler);
+}
+
+u64 Cartridge::UpdateRamHash(bool& remapNeeded)
+{
+	const Array<u64, 2> hashes = { m_PrgRam.UpdateHash(remapNeeded), m_ChrRam.UpdateHash(remapNeeded) };
+	return Hash::Hash64(hashes.data(), sizeof(hashes));
+}
+
+void Cartridge::Serialize(StateArchive& state)
+{
+	m_PrgRam.Serialize(state);
+	m_ChrRam.Serialize(state);
 }
@@ -1,26 +1,13 @@
 #pragma once
 
 #include "../Core/Common.h"
+#include "CowMemory.h"
+#include "RomImage.h"
 #include <filesystem>
 #include <memory>
+#include <optional>
 
-enum class MirrorMode : u8
-{
-	Horizontal,
-	Vertical,
-	SingleScreenLower,
-	SingleScreenUpper,
-	FourScreen
-};
-
-enum class CartridgeLoadResult
-{
-	Success = 0,
-	FileNotFound,
-	InvalidHeader,
-	InvalidPrgRomSize,
-	MissingData
-};
+class StateArchive;
 
 class Cartridge
 {
@@ -29,6 +16,11 @@ public:
 
 	[[nodiscard]] CartridgeLoadResult LoadFromFile(const std::filesystem::path& path);
 
+	// Uses image's ROM in place and allocates fresh RAM for this cartridge
+	void Load(std::shared_ptr<const RomImage> image);
+
+	const std::shared_ptr<const RomImage>& GetImage() const { return m_Image; }
+
 	u8 ReadPrgRom(usize offset) const;
 
 	// Returns std::nullopt when PRG RAM is missing
@@ -40,6 +32,39 @@ public:
 
 	void WriteChr(usize offset, u8 data);
 
+	// Direct pointers for the page tables. Offsets wrap the same way as
+	// the Read/Write functions; nullptr when there is no PRG-RAM. Write
+	// pointers are also nullptr while the RAM page is shared with a fork.
+	const u8* GetPrgRomPtr(usize offset) const { return &m_PrgRom[offset & (m_PrgRomSize - 1)]; }
+
+	const u8* GetPrgRamPtr(usize offset) const
+	{
+		return HasPrgRam() ? m_PrgRam.GetReadPtr(offset & (m_PrgRamSize - 1)) : nullptr;
+	}
+
+	u8* GetPrgRamWritePtr(usize offset) { return HasPrgRam() ? m_PrgRam.GetWritePtr(offset & (m_PrgRamSize - 1)) : nullptr; }
+
+	const u8* GetChrPtr(usize offset) const
+	{
+		offset &= m_ChrSize - 1;
+		return m_ChrRom ? &m_ChrRom[offset] : m_ChrRam.GetReadPtr(offset);
+	}
+
+	// nullptr for CHR-ROM
+	u8* GetChrRamPtr(usize offset) { return m_ChrRom ? nullptr : m_ChrRam.GetWritePtr(offset & (m_ChrSize - 1)); }
+
+	bool HasPrgRam() const { return m_PrgRam.GetSize() != 0; }
+
+	// Shares other's PRG-RAM and CHR-RAM pages, see CowMemory::ShareFrom.
+	// Both cartridges have to hold the same image.
+	void ShareRam(Cartridge& other);
+
+	// Called when a write to shared RAM moved a page, see CowMemory
+	void SetRemapHandler(const std::function<void()>& handler);
+
+	// Hash of PRG-RAM and CHR-RAM, see CowMemory::UpdateHash
+	u64 UpdateRamHash(bool& remapNeeded);
+
 	MirrorMode GetMirrorMode() const { return m_MirrorMode; }
 
 	usize GetPrgRomSize() const { return m_PrgRomSize; }
@@ -50,11 +75,17 @@ public:
 
 	u8 GetMapperNumber() const { return m_MapperNumber; }
 
+	// PRG-RAM and CHR-RAM contents, ROM is never part of a save state
+	void Serialize(StateArchive& state);
+
 private:
-	std::unique_ptr<u8[]> m_PrgRom = nullptr;
-	std::unique_ptr<u8[]> m_ChrRom = nullptr;
-	std::unique_ptr<u8[]> m_PrgRam = nullptr;
-	std::unique_ptr<u8[]> m_ChrRam = nullptr;
+	std::shared_ptr<const RomImage> m_Image = nullptr;
+	// Point into m_Image
+	const u8* m_PrgRom = nullptr;
+	const u8* m_ChrRom = nullptr;
+
+	CowMemory m_PrgRam{};
+	CowMemory m_ChrRam{};
 
 	std::unique_ptr<u8[]> m_Trainer = nullptr;
 
@@ -64,7 +95,4 @@ private:
 
 	MirrorMode m_MirrorMode = MirrorMode::Horizontal;
 	u8 m_MapperNumber = 0;
-
-	bool m_HasPrgRam = false;
-	bool m_HasTrainer = false;
 };
@@ -0,0 +1,176 @@
+#include "CowMemory.h"
+#include "SaveState.h"
+
+#include "../Core/Hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+CowMemory::~CowMemory()
+{
+	Release();
+}
+
+void CowMemory::Allocate(usize size)
+{
+	ASSERT((size & PAGE_MASK) == 0);
+
+	Release();
+	m_Pages.resize(size >> PAGE_SHIFT);
+	for (Page*& page : m_Pages)
+	{
+		page = new Page{};
+	}
+	m_PageHashes.assign(m_Pages.size(), 0);
+	m_Dirty.assign(m_Pages.size(), 1);
+}
+
+void CowMemory::Release()
+{
+	for (Page* page : m_Pages)
+	{
+		Unref(page);
+	}
+	m_Pages.clear();
+	m_PageHashes.clear();
+	m_Dirty.clear();
+	m_MaybeShared = false;
+}
+
+void CowMemory::ShareFrom(CowMemory& other)
+{
+	ASSERT(&other != this);
+
+	Release();
+	m_Pages = other.m_Pages;
+	for (Page* page : m_Pages)
+	{
+		page->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	// Same contents, so other's clean hashes hold here too
+	m_PageHashes = other.m_PageHashes;
+	m_Dirty = other.m_Dirty;
+	m_MaybeShared = !m_Pages.empty();
+	other.m_MaybeShared = m_MaybeShared;
+}
+
+void CowMemory::Unref(Page* page)
+{
+	if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete page;
+	}
+}
+
+bool CowMemory::MakePrivate(usize index, bool keep)
+{
+	Page* page = m_Pages[index];
+	if (page->refs.load(std::memory_order_acquire) == 1)
+	{
+		return false;
+	}
+
+	Page* copy = keep ? new Page : new Page{};
+	if (keep)
+	{
+		std::memcpy(copy->data, page->data, PAGE_SIZE);
+	}
+	m_Pages[index] = copy;
+	Unref(page);
+	return true;
+}
+
+void CowMemory::FinishWrites(bool changed)
+{
+	if (!changed && !m_MaybeShared)
+	{
+		return;
+	}
+
+	m_MaybeShared = std::any_of(m_Pages.begin(), m_Pages.end(),
+		[](const Page* page) { return page->refs.load(std::memory_order_acquire) != 1; });
+	if (m_Remap)
+	{
+		m_Remap();
+	}
+}
+
+bool CowMemory::MarkDirty(usize index)
+{
+	if (m_Dirty[index])
+	{
+		return false;
+	}
+	m_Dirty[index] = 1;
+	return true;
+}
+
+void CowMemory::Write(usize offset, u8 val)
+{
+	const usize index = offset >> PAGE_SHIFT;
+	bool changed = MakePrivate(index, true);
+	changed |= MarkDirty(index);
+	m_Pages[index]->data[offset & PAGE_MASK] = val;
+	FinishWrites(changed);
+}
+
+void CowMemory::Clear()
+{
+	bool changed = false;
+	for (usize i = 0; i < m_Pages.size(); i++)
+	{
+		changed |= MarkDirty(i);
+		if (!MakePrivate(i, false))
+		{
+			std::memset(m_Pages[i]->data, 0, PAGE_SIZE);
+		}
+		else
+		{
+			changed = true;
+		}
+	}
+	FinishWrites(changed);
+}
+
+void CowMemory::Serialize(StateArchive& state)
+{
+	if (state.SkipsSharedMemory())
+	{
+		return;
+	}
+
+	if (!state.IsLoading())
+	{
+		for (Page* page : m_Pages)
+		{
+			state.Bytes(page->data, PAGE_SIZE);
+		}
+		return;
+	}
+
+	// Loading overwrites every byte, so shared pages aren't copied first
+	bool changed = false;
+	for (usize i = 0; i < m_Pages.size(); i++)
+	{
+		changed |= MakePrivate(i, false);
+		changed |= MarkDirty(i);
+		state.Bytes(m_Pages[i]->data, PAGE_SIZE);
+	}
+	FinishWrites(changed);
+}
+
+u64 CowMemory::UpdateHash(bool& remapNeeded)
+{
+	for (usize i = 0; i < m_Pages.size(); i++)
+	{
+		if (!m_Dirty[i])
+		{
+			continue;
+		}
+		m_PageHashes[i] = Hash::Hash64(m_Pages[i]->data, PAGE_SIZE);
+		m_Dirty[i] = 0;
+		// Shared pages were never writable in place
+		remapNeeded |= m_Pages[i]->refs.load(std::memory_order_acquire) == 1;
+	}
+	return Hash::Hash64(m_PageHashes.data(), m_PageHashes.size() * sizeof(u64));
+}
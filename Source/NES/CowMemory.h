@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+class StateArchive;
+
+// RAM split into 1KB pages that forked NES instances share until one of
+// them writes. A page with more than one owner has no write pointer, so
+// page tables built from GetWritePtr send writes to it down the slow
+// path, where Write copies the page first and asks the owner to rebuild
+// its page tables through the remap handler.
+//
+// UpdateHash uses the same trick to find the pages written since it last
+// ran: it leaves every page clean and write-protected, and the first
+// write to one goes through Write, which marks it dirty and unprotects it.
+class CowMemory
+{
+public:
+	static constexpr usize PAGE_SHIFT = 10;
+	static constexpr usize PAGE_SIZE = 1 << PAGE_SHIFT;
+	static constexpr usize PAGE_MASK = PAGE_SIZE - 1;
+
+	CowMemory() = default;
+	~CowMemory();
+
+	CowMemory(const CowMemory&) = delete;
+	CowMemory& operator=(const CowMemory&) = delete;
+
+	// Replaces the contents with size bytes of zeroes, size being a whole
+	// number of pages
+	void Allocate(usize size);
+
+	void Release();
+
+	usize GetSize() const { return m_Pages.size() << PAGE_SHIFT; }
+
+	// Called after a write changed which page an offset lives in
+	void SetRemapHandler(std::function<void()> handler) { m_Remap = std::move(handler); }
+
+	// Drops this memory's pages for other's, which has to be the same
+	// size. Neither side can write in place afterwards, so both need their
+	// page tables rebuilt.
+	void ShareFrom(CowMemory& other);
+
+	const u8* GetReadPtr(usize offset) const { return m_Pages[offset >> PAGE_SHIFT]->data + (offset & PAGE_MASK); }
+
+	// nullptr while the page is shared, or clean since the last UpdateHash
+	u8* GetWritePtr(usize offset)
+	{
+		const usize index = offset >> PAGE_SHIFT;
+		Page* page = m_Pages[index];
+		return m_Dirty[index] && page->refs.load(std::memory_order_acquire) == 1 ?
+			page->data + (offset & PAGE_MASK) : nullptr;
+	}
+
+	u8 Read(usize offset) const { return *GetReadPtr(offset); }
+
+	void Write(usize offset, u8 val);
+
+	// Zeroes everything, shared pages are swapped for new ones
+	void Clear();
+
+	// Same bytes as a plain array of GetSize(). Skipped entirely when the
+	// archive leaves shared memory out.
+	void Serialize(StateArchive& state);
+
+	// Hash of the contents, rehashing only the pages written since the
+	// last call. Sets remapNeeded when pages that were writable in place
+	// just got protected; the owner has to rebuild its page tables before
+	// running on, or writes through them would go unnoticed.
+	u64 UpdateHash(bool& remapNeeded);
+
+private:
+	struct Page
+	{
+		std::atomic<u32> refs{ 1 };
+		alignas(CACHE_LINE_SIZE) u8 data[PAGE_SIZE];
+	};
+
+	// Gives this memory sole ownership of page index, copying its
+	// contents when keep is set. Returns true if the page was shared.
+	bool MakePrivate(usize index, bool keep);
+
+	static void Unref(Page* page);
+
+	// Runs the remap handler if any page was shared since the last call
+	void FinishWrites(bool changed);
+
+	// Marks index as differing from its cached hash. Returns true if it
+	// was clean, so its page table entries are out of date.
+	bool MarkDirty(usize index);
+
+private:
+	std::vector<Page*> m_Pages{};
+	// Per page, hash of the contents as of the last UpdateHash, valid
+	// unless the page is dirty
+	std::vector<u64> m_PageHashes{};
+	std::vector<u8> m_Dirty{};
+	std::function<void()> m_Remap{};
+	// Set by ShareFrom on both sides, cleared once every page is private
+	// again. While set a slow path write to a private page still remaps,
+	// since the page tables may predate the other side letting go of it.
+	bool m_MaybeShared = false;
+};
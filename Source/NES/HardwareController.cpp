@@ -1,4 +1,5 @@
 #include "HardwareController.h"
+#include "SaveState.h"
 #include "../Core/Logger.h"
 
 void HardwareController::SetButtonState(NESButton button, bool pressed)
@@ -45,4 +46,11 @@ void HardwareController::Write(bool bit)
 	{
 		m_ShiftReg = m_ControllerState;
 	}
-}
\ No newline at end of file
+}
+
+void HardwareController::Serialize(StateArchive& state)
+{
+	state.Value(m_ShiftStrobe);
+	state.Value(m_ControllerState);
+	state.Value(m_ShiftReg);
+}
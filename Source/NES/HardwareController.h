@@ -2,6 +2,8 @@
 
 #include "../Core/Common.h"
 
+class StateArchive;
+
 enum class NESButton
 {
 	A,
@@ -25,6 +27,8 @@ public:
 
 	void Write(bool bit);
 
+	void Serialize(StateArchive& state);
+
 private:
 	bool m_ShiftStrobe = 0;
 	u8 m_ControllerState = 0;
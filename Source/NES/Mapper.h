@@ -7,6 +7,9 @@
 enum class MirrorMode : u8;
 class Cartridge;
 class CPU;
+class CPUBus;
+class PPU;
+class StateArchive;
 
 #define MAPPER_BASE_PUBLIC_INTERFACE(name) \
 	name() = default; \
@@ -15,6 +18,9 @@ class CPU;
 	void CpuWrite(u16 addr, u8 data) override; \
 	std::optional<u8> PpuRead(u16 addr) override; \
 	void PpuWrite(u16 addr, u8 data) override; \
+	void UpdateCpuMemoryMap() override; \
+	void UpdatePpuMemoryMap() override; \
+	void Serialize(StateArchive& state) override; \
 
 class Mapper
 {
@@ -35,25 +41,58 @@ public:
 
 	virtual void PpuWrite(u16 addr, u8 data) = 0;
 
+	// Points the bus page table for $6000-$FFFF at the currently banked
+	// PRG-ROM and PRG-RAM. Pages left unmapped fall back to CpuRead and
+	// CpuWrite. Called on connect and after every bank switch.
+	virtual void UpdateCpuMemoryMap() = 0;
+
+	// Points the PPU's pattern table and nametable pages at the currently
+	// banked CHR and mirrored VRAM. Same contract as UpdateCpuMemoryMap.
+	virtual void UpdatePpuMemoryMap() = 0;
+
+	// Bank registers and mirroring. The memory maps are not included,
+	// callers rebuild them with Update*MemoryMap after loading.
+	virtual void Serialize(StateArchive& state);
+
+	void ConnectBus(CPUBus* bus);
+
+	void ConnectPpu(PPU* ppu);
+
 	// Takes in nametable offset, returns mirrored VRAM addr 
 	// or std::nullopt if mapper redirects to cartridge
 	virtual std::optional<u16> NametableMirror(u16 offset);
 
 	MirrorMode GetMirrorMode() const { return m_MirrorMode; }
 
+protected:
+	// Maps [begin, end) to PRG-RAM starting at offset, or unmaps it when
+	// the cartridge has none
+	void MapPrgRam(u32 begin, u32 end, usize offset, bool readable);
+
+	void MapPrgRom(u32 begin, u32 end, usize offset);
+
+	// Maps [begin, end) of the pattern tables to CHR starting at offset.
+	// Writes are only mapped for CHR-RAM.
+	void MapChr(u32 begin, u32 end, usize offset, bool writable);
+
+	// Maps the four nametables following NametableMirror
+	void MapNametables();
+
 protected:
 	Cartridge* m_Cartridge = nullptr;
 	CPU* m_Cpu = nullptr;
+	CPUBus* m_Bus = nullptr;
+	PPU* m_Ppu = nullptr;
 	MirrorMode m_MirrorMode = MirrorMode::SingleScreenLower;
 };
 
-class NROM : public Mapper
+class NROM final : public Mapper
 {
 public:
 	MAPPER_BASE_PUBLIC_INTERFACE(NROM)
 };
 
-class CNROM : public Mapper
+class CNROM final : public Mapper
 {
 public:
 	MAPPER_BASE_PUBLIC_INTERFACE(CNROM)
@@ -62,7 +101,7 @@ private:
 	u8 m_ChrRomBank = 0;
 };
 
-class MMC1 : public Mapper
+class MMC1 final : public Mapper
 {
 public:
 	MAPPER_BASE_PUBLIC_INTERFACE(MMC1)
@@ -74,6 +113,8 @@ private:
 	void UpdateChrBank1();
 	void UpdatePrgBank();
 
+	usize PrgRomOffset(u16 addr) const;
+
 private:
 	enum class PrgRomBankMode
 	{
@@ -1,6 +1,7 @@
 #include "../Mapper.h"
 #include "../../Core/Logger.h"
 #include "../Cartridge.h"
+#include "../SaveState.h"
 
 void CNROM::Init(Cartridge* cartridge, CPU* cpu) 
 {
@@ -39,6 +40,8 @@ void CNROM::CpuWrite(u16 addr, u8 data)
 	else if (addr >= 0x8000)
 	{
 		m_ChrRomBank = data & 0b11;
+		UpdatePpuMemoryMap();
+		return;
 	}
 	LOG_VERBOSE("Invalid CPU write to %hx", addr);
 }
@@ -58,4 +61,27 @@ void CNROM::PpuWrite(u16 addr, u8 data)
 {
 	// no writes allowed, do nothing
 	LOG_VERBOSE("Invalid PPU write to %hx", addr);
-}
\ No newline at end of file
+}
+
+void CNROM::UpdateCpuMemoryMap()
+{
+	// 2KB of PRG-RAM mirrored across $6000-$7FFF
+	for (u32 addr = 0x6000; addr < 0x8000; addr += 0x800)
+	{
+		MapPrgRam(addr, addr + 0x800, 0, true);
+	}
+	MapPrgRom(0x8000, 0x10000, 0);
+}
+
+void CNROM::UpdatePpuMemoryMap()
+{
+	// PpuWrite ignores writes, so nothing is mapped writable
+	MapChr(0x0000, 0x2000, m_ChrRomBank * 0x2000, false);
+	MapNametables();
+}
+
+void CNROM::Serialize(StateArchive& state)
+{
+	Mapper::Serialize(state);
+	state.Value(m_ChrRomBank);
+}
@@ -2,6 +2,7 @@
 #include "../Cartridge.h"
 #include "../../Core/Logger.h"
 #include "../CPU.h"
+#include "../SaveState.h"
 
 void MMC1::Init(Cartridge* cartridge, CPU* cpu) 
 {
@@ -29,41 +30,74 @@ std::optional<u8> MMC1::CpuRead(u16 addr)
 			return m_Cartridge->ReadPrgRam(addr & 0x1FFF);
 		}
 	}
+	else
+	{
+		return m_Cartridge->ReadPrgRom(PrgRomOffset(addr));
+	}
+	LOG_VERBOSE("Invalid CPU read from %hx", addr);
+	return std::nullopt;
+}
+
+usize MMC1::PrgRomOffset(u16 addr) const
+{
+	usize offset = addr & 0x3FFF;
+
 	// PRG_ROM bank 0
-	else if (addr < 0xC000)
+	if (addr < 0xC000)
 	{
-		usize offset = addr & 0x3FFF;
 		if (m_PrgRomBankMode != PrgRomBankMode::Fix0)
 		{
 			offset |= m_PrgRomBank << 14u;
 		}
-		return m_Cartridge->ReadPrgRom(offset);
+		return offset;
 	}
+
 	// PRG_ROM bank 1
-	else
+	const u8 lastBank = (m_Cartridge->GetPrgRomSize() >> 14) - 1;
+
+	switch (m_PrgRomBankMode)
 	{
-		usize offset = addr & 0x3FFF;
+	case PrgRomBankMode::SwitchBoth0:
+	case PrgRomBankMode::SwitchBoth1:
+		offset |= ((m_PrgRomBank | 1u) << 14u);
+		break;
+	case PrgRomBankMode::Fix0:
+		offset |= (m_PrgRomBank << 14u);
+		break;
+	// last bank
+	case PrgRomBankMode::Fix1:
+		offset |= lastBank * 0x4000;
+		break;
+	}
+	return offset;
+}
 
-		const u8 lastBank = (m_Cartridge->GetPrgRomSize() >> 14) - 1;
+void MMC1::UpdateCpuMemoryMap()
+{
+	// Writes to PRG-RAM go through even while it is disabled for reads
+	MapPrgRam(0x6000, 0x8000, 0, !m_PrgRamDisabled);
+	MapPrgRom(0x8000, 0xC000, PrgRomOffset(0x8000));
+	MapPrgRom(0xC000, 0x10000, PrgRomOffset(0xC000));
+}
 
-		switch (m_PrgRomBankMode)
-		{
-		case PrgRomBankMode::SwitchBoth0:
-		case PrgRomBankMode::SwitchBoth1:
-			offset |= ((m_PrgRomBank | 1u) << 14u);
-			break;
-		case PrgRomBankMode::Fix0:
-			offset |= (m_PrgRomBank << 14u);
-			break;
-		// last bank
-		case PrgRomBankMode::Fix1:
-			offset |= lastBank * 0x4000;
-			break;
-		}
-		return m_Cartridge->ReadPrgRom(offset);
-	}
-	LOG_VERBOSE("Invalid CPU read from %hx", addr);
-	return std::nullopt;
+void MMC1::UpdatePpuMemoryMap()
+{
+	MapChr(0x0000, 0x1000, m_ChrBank0 << 12, true);
+	MapChr(0x1000, 0x2000, m_ChrBank1 << 12, true);
+	MapNametables();
+}
+
+void MMC1::Serialize(StateArchive& state)
+{
+	Mapper::Serialize(state);
+	state.Value(m_ShiftReg);
+	state.Value(m_PrgRomBankMode);
+	state.Value(m_ChrRomBankMode);
+	state.Value(m_ChrBank0);
+	state.Value(m_ChrBank1);
+	state.Value(m_PrgRomBank);
+	state.Value(m_PrgRamDisabled);
+	state.Value(m_LastCpuWrite);
 }
 
 void MMC1::CpuWrite(u16 addr, u8 data)
@@ -146,6 +180,8 @@ void MMC1::UpdateBank(u16 addr)
 	case 2: UpdateChrBank1(); break;
 	case 3: UpdatePrgBank(); break;
 	}
+	UpdateCpuMemoryMap();
+	UpdatePpuMemoryMap();
 }
 
 void MMC1::UpdateControl()
@@ -2,6 +2,45 @@
 
 #include "../NES.h"
 #include "../Cartridge.h"
+#include "../CPUBus.h"
+#include "../CowMemory.h"
+#include "../PPU.h"
+#include "../SaveState.h"
+
+void Mapper::ConnectBus(CPUBus* bus)
+{
+	m_Bus = bus;
+	UpdateCpuMemoryMap();
+}
+
+void Mapper::ConnectPpu(PPU* ppu)
+{
+	m_Ppu = ppu;
+	UpdatePpuMemoryMap();
+}
+
+void Mapper::Serialize(StateArchive& state)
+{
+	state.Value(m_MirrorMode);
+}
+
+void Mapper::MapPrgRam(u32 begin, u32 end, usize offset, bool readable)
+{
+	for (u32 addr = begin; addr < end; addr += CPUBus::PAGE_SIZE)
+	{
+		const usize ramOffset = offset + (addr - begin);
+		m_Bus->MapReadPage(addr, readable ? m_Cartridge->GetPrgRamPtr(ramOffset) : nullptr);
+		m_Bus->MapWritePage(addr, m_Cartridge->GetPrgRamWritePtr(ramOffset));
+	}
+}
+
+void Mapper::MapPrgRom(u32 begin, u32 end, usize offset)
+{
+	for (u32 addr = begin; addr < end; addr += CPUBus::PAGE_SIZE)
+	{
+		m_Bus->MapReadPage(addr, m_Cartridge->GetPrgRomPtr(offset + (addr - begin)));
+	}
+}
 
 std::optional<u16> Mapper::NametableMirror(u16 offset)
 {
@@ -26,4 +65,30 @@ std::optional<u16> Mapper::NametableMirror(u16 offset)
 		return std::nullopt;
 	}
 	return (table << 10) | tableOffset;
+}
+
+void Mapper::MapChr(u32 begin, u32 end, usize offset, bool writable)
+{
+	for (u32 addr = begin; addr < end; addr += PPU::PAGE_SIZE)
+	{
+		const usize chrOffset = offset + (addr - begin);
+		m_Ppu->MapChrPage(addr, m_Cartridge->GetChrPtr(chrOffset), writable ? m_Cartridge->GetChrRamPtr(chrOffset) : nullptr);
+	}
+}
+
+void Mapper::MapNametables()
+{
+	for (u16 offset = 0; offset < 0x1000; offset += PPU::PAGE_SIZE)
+	{
+		const std::optional<u16> mirrored = NametableMirror(offset);
+		if (mirrored)
+		{
+			CowMemory& vram = m_Ppu->GetVram();
+			m_Ppu->MapNametablePage(offset, vram.GetReadPtr(*mirrored), vram.GetWritePtr(*mirrored));
+		}
+		else
+		{
+			m_Ppu->MapNametablePage(offset, nullptr, nullptr);
+		}
+	}
 }
\ No newline at end of file
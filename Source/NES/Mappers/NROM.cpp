@@ -1,6 +1,7 @@
 #include "../Mapper.h"
 #include "../../Core/Logger.h"
 #include "../Cartridge.h"
+#include "../SaveState.h"
 
 void NROM::Init(Cartridge* cartridge, CPU* cpu)
 {
@@ -55,4 +56,21 @@ std::optional<u8> NROM::PpuRead(u16 addr)
 void NROM::PpuWrite(u16 addr, u8 data)
 {
 	m_Cartridge->WriteChr(addr, data);
-}
\ No newline at end of file
+}
+
+void NROM::UpdateCpuMemoryMap()
+{
+	MapPrgRam(0x6000, 0x8000, 0, true);
+	MapPrgRom(0x8000, 0x10000, 0);
+}
+
+void NROM::UpdatePpuMemoryMap()
+{
+	MapChr(0x0000, 0x2000, 0, true);
+	MapNametables();
+}
+
+void NROM::Serialize(StateArchive& state)
+{
+	Mapper::Serialize(state);
+}
@@ -0,0 +1,291 @@
+#include "Movie.h"
+
+#include "../Core/Hash.h"
+#include "NES.h"
+#include "RomImage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// File layout, little endian:
+//   MovieHeader
+//   resets      resetCount varints, each the distance from the previous
+//               reset frame (from 0 for the first)
+//   input       runCount pairs of buttons byte, varint run length
+//   hashes      frameCount u64, only with MOVIE_FLAG_STATE_HASHES
+
+static constexpr u16 MOVIE_FLAG_STATE_HASHES = 1 << 0;
+
+struct MovieHeader
+{
+	u32 magic = Movie::MAGIC;
+	u16 version = Movie::VERSION;
+	u16 flags = 0;
+	u64 romHash = 0;
+	u32 frameCount = 0;
+	u32 resetCount = 0;
+	u32 runCount = 0;
+	u32 reserved = 0;
+};
+
+static void WriteVarint(std::vector<u8>& out, u32 val)
+{
+	while (val >= 0x80)
+	{
+		out.push_back(static_cast<u8>(val | 0x80));
+		val >>= 7;
+	}
+	out.push_back(static_cast<u8>(val));
+}
+
+static bool ReadVarint(const u8*& in, const u8* end, u32& val)
+{
+	val = 0;
+	for (u32 shift = 0; shift < 32; shift += 7)
+	{
+		if (in == end)
+		{
+			return false;
+		}
+		const u8 byte = *in++;
+		val |= static_cast<u32>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static u64 HashRom(const RomImage& image)
+{
+	u64 hash = Hash::Hash64(image.GetPrgRom(), image.GetPrgRomSize(), image.GetMapperNumber());
+	if (image.GetChrRom())
+	{
+		hash = Hash::Hash64(image.GetChrRom(), image.GetChrSize(), hash);
+	}
+	return hash;
+}
+
+void Movie::Begin(const RomImage& image, bool stateHashes)
+{
+	m_RomHash = HashRom(image);
+	m_HasStateHashes = stateHashes;
+	m_Buttons.clear();
+	m_ResetFrames.clear();
+	m_StateHashes.clear();
+}
+
+void Movie::AddFrame(u8 buttons, bool reset, u64 stateHash)
+{
+	if (reset)
+	{
+		m_ResetFrames.push_back(static_cast<u32>(m_Buttons.size()));
+	}
+	m_Buttons.push_back(buttons);
+	if (m_HasStateHashes)
+	{
+		m_StateHashes.push_back(stateHash);
+	}
+}
+
+void Movie::Truncate(usize frameCount)
+{
+	if (frameCount >= m_Buttons.size())
+	{
+		return;
+	}
+	m_Buttons.resize(frameCount);
+	if (m_HasStateHashes)
+	{
+		m_StateHashes.resize(frameCount);
+	}
+	const auto firstDropped = std::lower_bound(m_ResetFrames.begin(), m_ResetFrames.end(), frameCount);
+	m_ResetFrames.erase(firstDropped, m_ResetFrames.end());
+}
+
+void Movie::ApplyFrame(NES& nes, usize frame) const
+{
+	if (IsReset(frame))
+	{
+		nes.Reset();
+	}
+	nes.SetButtonsState(m_Buttons[frame]);
+}
+
+bool Movie::IsReset(usize frame) const
+{
+	return std::binary_search(m_ResetFrames.begin(), m_ResetFrames.end(), static_cast<u32>(frame));
+}
+
+bool Movie::MatchesRom(const RomImage& image) const
+{
+	return HashRom(image) == m_RomHash;
+}
+
+MovieResult Movie::Save(const std::filesystem::path& path) const
+{
+	std::vector<u8> data(sizeof(MovieHeader));
+
+	u32 previous = 0;
+	for (const u32 frame : m_ResetFrames)
+	{
+		WriteVarint(data, frame - previous);
+		previous = frame;
+	}
+
+	u32 runCount = 0;
+	for (usize run = 0; run < m_Buttons.size();)
+	{
+		usize end = run + 1;
+		while (end < m_Buttons.size() && m_Buttons[end] == m_Buttons[run])
+		{
+			end++;
+		}
+		data.push_back(m_Buttons[run]);
+		WriteVarint(data, static_cast<u32>(end - run));
+		runCount++;
+		run = end;
+	}
+
+	if (m_HasStateHashes)
+	{
+		const usize offset = data.size();
+		data.resize(offset + m_StateHashes.size() * sizeof(u64));
+		std::memcpy(data.data() + offset, m_StateHashes.data(), m_StateHashes.size() * sizeof(u64));
+	}
+
+	MovieHeader header{};
+	header.flags = m_HasStateHashes ? MOVIE_FLAG_STATE_HASHES : 0;
+	header.romHash = m_RomHash;
+	header.frameCount = static_cast<u32>(m_Buttons.size());
+	header.resetCount = static_cast<u32>(m_ResetFrames.size());
+	header.runCount = runCount;
+	std::memcpy(data.data(), &header, sizeof(header));
+
+	std::ofstream outf{ path, std::ios::binary | std::ios::trunc };
+	if (!outf.write(reinterpret_cast<const char*>(data.data()), data.size()))
+	{
+		return MovieResult::WriteFailed;
+	}
+	return MovieResult::Success;
+}
+
+MovieResult Movie::Load(const std::filesystem::path& path)
+{
+	std::ifstream inf{ path, std::ios::binary | std::ios::ate };
+	if (!inf)
+	{
+		return MovieResult::FileNotFound;
+	}
+
+	const std::streamoff fileSize = inf.tellg();
+	if (fileSize < static_cast<std::streamoff>(sizeof(MovieHeader)))
+	{
+		return MovieResult::InvalidFormat;
+	}
+	inf.seekg(0);
+
+	std::vector<u8> data(fileSize);
+	if (!inf.read(reinterpret_cast<char*>(data.data()), fileSize))
+	{
+		return MovieResult::InvalidFormat;
+	}
+
+	MovieHeader header{};
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != MAGIC)
+	{
+		return MovieResult::InvalidFormat;
+	}
+	if (header.version != VERSION)
+	{
+		return MovieResult::VersionMismatch;
+	}
+
+	const u8* in = data.data() + sizeof(header);
+	const u8* end = data.data() + data.size();
+	const bool hasStateHashes = header.flags & MOVIE_FLAG_STATE_HASHES;
+
+	// Every count is checked against the bytes that could hold it before
+	// anything is sized from it: a reset is at least a 1 byte varint, a
+	// run at least 2 bytes
+	const u64 minBytes = u64{ header.resetCount } + u64{ header.runCount } * 2 +
+						 (hasStateHashes ? u64{ header.frameCount } * sizeof(u64) : 0);
+	if (minBytes > static_cast<u64>(end - in))
+	{
+		return MovieResult::InvalidFormat;
+	}
+
+	std::vector<u32> resetFrames(header.resetCount);
+	u64 frame = 0;
+	for (usize i = 0; i < resetFrames.size(); i++)
+	{
+		u32 delta;
+		if (!ReadVarint(in, end, delta))
+		{
+			return MovieResult::InvalidFormat;
+		}
+		// Strictly ascending, IsReset and Truncate search the list, and
+		// every reset is on a frame of the movie
+		frame += delta;
+		if ((i > 0 && delta == 0) || frame >= header.frameCount)
+		{
+			return MovieResult::InvalidFormat;
+		}
+		resetFrames[i] = static_cast<u32>(frame);
+	}
+
+	// The runs have to add up to frameCount before it's allocated, a
+	// corrupt header can't ask for more than the file encodes
+	const u8* runs = in;
+	u64 runFrames = 0;
+	for (u32 run = 0; run < header.runCount; run++)
+	{
+		u32 length;
+		if (in == end)
+		{
+			return MovieResult::InvalidFormat;
+		}
+		in++;
+		if (!ReadVarint(in, end, length))
+		{
+			return MovieResult::InvalidFormat;
+		}
+		runFrames += length;
+	}
+	if (runFrames != header.frameCount)
+	{
+		return MovieResult::InvalidFormat;
+	}
+
+	std::vector<u8> buttons(header.frameCount);
+	u8* out = buttons.data();
+	for (u32 run = 0; run < header.runCount; run++)
+	{
+		// Can't fail, the runs were all read once already
+		u32 length;
+		const u8 value = *runs++;
+		ReadVarint(runs, end, length);
+		out = std::fill_n(out, length, value);
+	}
+
+	std::vector<u64> stateHashes;
+	if (hasStateHashes)
+	{
+		if (static_cast<usize>(end - in) < header.frameCount * sizeof(u64))
+		{
+			return MovieResult::InvalidFormat;
+		}
+		stateHashes.resize(header.frameCount);
+		std::memcpy(stateHashes.data(), in, header.frameCount * sizeof(u64));
+	}
+
+	m_RomHash = header.romHash;
+	m_HasStateHashes = hasStateHashes;
+	m_Buttons = std::move(buttons);
+	m_ResetFrames = std::move(resetFrames);
+	m_StateHashes = std::move(stateHashes);
+	return MovieResult::Success;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <filesystem>
+#include <vector>
+
+class NES;
+class RomImage;
+
+enum class MovieResult
+{
+	Success = 0,
+	FileNotFound,
+	WriteFailed,
+	InvalidFormat,
+	VersionMismatch
+};
+
+// Controller input for a run from power-on: the byte given to
+// NES::SetButtonsState every frame and the frames that started with a
+// reset, optionally with the NES::GetStateHash after every frame so a
+// replay can tell exactly where it desynced. On disk the input is run
+// length encoded, a held button costs nothing per frame.
+class Movie
+{
+public:
+	static constexpr u32 MAGIC = 0x4D53454E; // "NESM"
+	// Also bumped when NES::GetStateHash changes how it hashes, since the
+	// recorded hashes stop matching
+	static constexpr u16 VERSION = 3;
+
+	// Empties the movie and ties it to image. Without stateHashes only
+	// the input is kept.
+	void Begin(const RomImage& image, bool stateHashes = true);
+
+	// reset means NES::Reset ran before the frame's input was set.
+	// stateHash is ignored unless the movie keeps hashes.
+	void AddFrame(u8 buttons, bool reset, u64 stateHash = 0);
+
+	// Drops every frame from frameCount on, for rewinding mid-recording
+	void Truncate(usize frameCount);
+
+	// Sets up nes for frame, call before its StepFrame
+	void ApplyFrame(NES& nes, usize frame) const;
+
+	usize GetFrameCount() const { return m_Buttons.size(); }
+
+	u8 GetButtons(usize frame) const { return m_Buttons[frame]; }
+
+	bool IsReset(usize frame) const;
+
+	bool HasStateHashes() const { return m_HasStateHashes; }
+
+	// State after frame ran, only valid with HasStateHashes
+	u64 GetStateHash(usize frame) const { return m_StateHashes[frame]; }
+
+	// Whether the movie was recorded on image, replays of anything else
+	// desync straight away
+	bool MatchesRom(const RomImage& image) const;
+
+	MovieResult Save(const std::filesystem::path& path) const;
+
+	MovieResult Load(const std::filesystem::path& path);
+
+private:
+	u64 m_RomHash = 0;
+	bool m_HasStateHashes = false;
+
+	std::vector<u8> m_Buttons{};
+	// Ascending
+	std::vector<u32> m_ResetFrames{};
+	std::vector<u64> m_StateHashes{};
+};
@@ -1,10 +1,21 @@
 #include "NES.h"
 
+#include "../Core/Hash.h"
 #include "../Core/Logger.h"
 
+#include <cstring>
+
 NES::NES() 
 {
-	
+	m_Wram.Allocate(WRAM_SIZE);
+	m_Vram.Allocate(VRAM_SIZE);
+
+	const auto remap = [this] { RemapMemory(); };
+	m_Wram.SetRemapHandler(remap);
+	m_Vram.SetRemapHandler(remap);
+	m_Cartridge.SetRemapHandler(remap);
+
+	m_Apu.Attach(&m_Cpu, &m_CpuBus);
 }
 
 bool NES::LoadROM(const std::filesystem::path& path)
@@ -12,58 +23,129 @@ bool NES::LoadROM(const std::filesystem::path& path)
 	const std::string pathStr = path.string();
 	const std::string fileStr = path.filename().string();
 
-	if (m_Cartridge.LoadFromFile(path) != CartridgeLoadResult::Success)
+	std::shared_ptr<const RomImage> image;
+	if (RomImage::LoadFromFile(path, image) != CartridgeLoadResult::Success)
 	{
 		LOG_ERROR("Failed to load ROM at %s", pathStr.c_str());
 		return false;
 	}
 
-	switch (m_Cartridge.GetMapperNumber())
+	if (!LoadROM(std::move(image)))
+	{
+		LOG_ERROR("Cartridge at %s has unsupported mapper", pathStr.c_str());
+		return false;
+	}
+
+	auto toKB = [](usize sizeBytes){ return sizeBytes >> 10; };
+
+	LOG_INFO("Loaded cartridge %s, PRG_ROM=%uKB, PRG_RAM=%uKB, CHR=%uKB, Mapper=%u",
+			 fileStr.c_str(),
+			 toKB(m_Cartridge.GetPrgRomSize()),
+			 toKB(m_Cartridge.GetPrgRamSize()),
+			 toKB(m_Cartridge.GetChrSize()),
+			 m_Cartridge.GetMapperNumber());
+	
+	return true;
+}
+
+bool NES::LoadROM(std::shared_ptr<const RomImage> image)
+{
+	std::unique_ptr<Mapper> mapper;
+	switch (image->GetMapperNumber())
 	{
 	case 0:
-		m_Mapper = std::make_unique<NROM>();
+		mapper = std::make_unique<NROM>();
 		break;
 	case 1:
-		m_Mapper = std::make_unique<MMC1>();
+		mapper = std::make_unique<MMC1>();
 		break;
 	case 3:
-		m_Mapper = std::make_unique<CNROM>();
+		mapper = std::make_unique<CNROM>();
 		break;
 	default:
-		LOG_ERROR("Cartridge at %s has unsupported mapper", pathStr.c_str());
 		return false;
 	}
 
+	m_Cartridge.Load(std::move(image));
+	m_Mapper = std::move(mapper);
+
 	m_Mapper->Init(&m_Cartridge, &m_Cpu);
-	m_Ppu.Attach(&m_Cpu, m_Mapper.get());
-	m_CpuBus.Attach(m_Mapper.get(), &m_Ppu, m_Wram.data(), &m_Controller);
+	m_Ppu.Attach(&m_Cpu, m_Mapper.get(), &m_Vram);
+	m_CpuBus.Attach(m_Mapper.get(), &m_Ppu, &m_Apu, &m_Wram, &m_Controller);
 	m_Cpu.Attach(&m_CpuBus);
 
-	auto toKB = [](usize sizeBytes){ return sizeBytes >> 10; };
+	StateArchive measure = StateArchive::ForMeasure();
+	Serialize(measure);
+	m_SaveStateSize = sizeof(SaveStateHeader) + measure.GetOffset();
+
+	StateArchive measureFork = StateArchive::ForMeasure(true);
+	Serialize(measureFork);
+	m_ForkState.resize(measureFork.GetOffset());
+	m_HashState.resize(measureFork.GetOffset());
 
-	LOG_INFO("Loaded cartridge %s, PRG_ROM=%uKB, PRG_RAM=%uKB, CHR=%uKB, Mapper=%u",
-			 fileStr.c_str(),
-			 toKB(m_Cartridge.GetPrgRomSize()),
-			 toKB(m_Cartridge.GetPrgRamSize()),
-			 toKB(m_Cartridge.GetChrSize()),
-			 m_Cartridge.GetMapperNumber());
-	
 	return true;
 }
 
 void NES::Reset()
 {
+	SyncPpu();
+	SyncApu();
 	m_Cpu.Reset();
 	m_Ppu.Reset();
+	m_Apu.Reset();
 }
 
 void NES::StepFrame()
 {
-	while (!m_Ppu.FramebufferReady())
+	// The whole visible part of the frame runs inside this call, so the
+	// PPU renders either all of it or none
+	const bool render = m_VideoOutput && m_FramesToSkip == 0;
+	if (m_VideoOutput)
+	{
+		m_FramesToSkip = render ? m_FrameSkip : m_FramesToSkip - 1;
+	}
+	m_Ppu.SetOutputEnabled(render);
+
+	switch (m_SchedulerMode)
 	{
-		Update();
+	case SchedulerMode::Lockstep:
+		while (!m_Ppu.FramebufferReady())
+		{
+			Update();
+		}
+		break;
+	case SchedulerMode::CatchUp:
+		if (m_CpuExecutionMode == CpuExecutionMode::Instruction)
+		{
+			while (!m_Ppu.FramebufferReady())
+			{
+				UpdateInstruction();
+			}
+		}
+		else
+		{
+			while (!m_Ppu.FramebufferReady())
+			{
+				UpdateCatchUp();
+			}
+		}
+		break;
 	}
 	m_Ppu.ClearFramebufferReady();
+	m_FrameRendered = render;
+	m_Apu.EndFrame();
+}
+
+void NES::SetVideoOutput(bool enabled)
+{
+	m_VideoOutput = enabled;
+	m_Ppu.SetOutputEnabled(enabled);
+}
+
+void NES::SetFrameSkip(u32 skip)
+{
+	m_FrameSkip = skip;
+	m_FramesToSkip = 0;
 }
 
 void NES::Update()
@@ -72,9 +154,69 @@ void NES::Update()
 	m_Ppu.PerformCycle();
 	m_Ppu.PerformCycle();
 	m_Ppu.PerformCycle();
+	CheckApuEvent();
+}
+
+void NES::UpdateCatchUp()
+{
+	m_Cpu.PerformCycle();
+
+	// Bus accesses inside the cycle already synced the PPU and APU if they
+	// touched them; only events the CPU observes passively (NMI, IRQs, end
+	// of frame) are left to check here
+	const u64 dot = m_Cpu.GetCycle() * PPU::DOTS_PER_CPU_CYCLE;
+	if (dot >= m_Ppu.GetNextEventDot())
+	{
+		m_Ppu.CatchUp(dot);
+	}
+	CheckApuEvent();
+}
+
+void NES::UpdateInstruction()
+{
+	// Register and mapper accesses inside the instruction sync the PPU and
+	// APU themselves. The only thing a whole instruction can miss is one of
+	// their events, so take the per-cycle path when one could land inside
+	// it, and while DMA is stalling the CPU.
+	const u64 lastCycle = m_Cpu.GetCycle() + CPU::MAX_INSTRUCTION_CYCLES;
+	const u64 lastDot = lastCycle * PPU::DOTS_PER_CPU_CYCLE;
+	if (m_Cpu.AtInstructionBoundary() && lastDot < m_Ppu.GetNextEventDot() && lastCycle < m_Apu.GetNextEventCycle())
+	{
+		m_Cpu.ExecuteInstruction();
+		return;
+	}
+	UpdateCatchUp();
+}
+
+void NES::SyncPpu()
+{
+	m_Ppu.CatchUp(m_Cpu.GetCycle() * PPU::DOTS_PER_CPU_CYCLE);
+}
+
+void NES::SyncApu()
+{
+	m_Apu.CatchUp(m_Cpu.GetCycle());
+}
+
+void NES::RemapMemory()
+{
+	if (!m_Mapper)
+	{
+		return;
+	}
+	m_CpuBus.MapRam();
+	m_Mapper->UpdateCpuMemoryMap();
+	m_Mapper->UpdatePpuMemoryMap();
+}
+
+void NES::SetSchedulerMode(SchedulerMode mode)
+{
+	// Owed dots have to be paid before lockstep takes over
+	SyncPpu();
+	m_SchedulerMode = mode;
 }
 
-const u8* NES::GetFramebuffer() const
+const u16* NES::GetFramebuffer() const
 {
 	return m_Ppu.GetFramebuffer();
 }
@@ -83,3 +225,160 @@ void NES::SetButtonsState(u8 state)
 {
 	m_Controller.SetButtonsState(state);
 }
+
+SaveStateHeader NES::MakeSaveStateHeader() const
+{
+	SaveStateHeader header{};
+	header.mapperNumber = m_Cartridge.GetMapperNumber();
+	header.prgRomSize = static_cast<u32>(m_Cartridge.GetPrgRomSize());
+	header.chrSize = static_cast<u32>(m_Cartridge.GetChrSize());
+	header.prgRamSize = static_cast<u32>(m_Cartridge.GetPrgRamSize());
+	header.stateSize = static_cast<u32>(m_SaveStateSize);
+	return header;
+}
+
+void NES::Serialize(StateArchive& state)
+{
+	m_Cpu.Serialize(state);
+	m_Ppu.Serialize(state);
+	m_CpuBus.Serialize(state);
+	m_Apu.Serialize(state);
+	m_Wram.Serialize(state);
+	m_Controller.Serialize(state);
+	m_Mapper->Serialize(state);
+	m_Cartridge.Serialize(state);
+}
+
+SaveStateResult NES::SaveState(std::span<u8> buffer)
+{
+	if (!m_Mapper)
+	{
+		return SaveStateResult::NoCartridge;
+	}
+	if (buffer.size() < m_SaveStateSize)
+	{
+		return SaveStateResult::BufferTooSmall;
+	}
+
+	// The PPU and APU have to stand where the CPU is for the state to be
+	// consistent
+	SyncPpu();
+	SyncApu();
+
+	const SaveStateHeader header = MakeSaveStateHeader();
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	StateArchive state = StateArchive::ForSave(buffer.subspan(sizeof(header)));
+	Serialize(state);
+	return SaveStateResult::Success;
+}
+
+SaveStateResult NES::LoadState(std::span<const u8> buffer)
+{
+	if (!m_Mapper)
+	{
+		return SaveStateResult::NoCartridge;
+	}
+	if (buffer.size() < sizeof(SaveStateHeader))
+	{
+		return SaveStateResult::BufferTooSmall;
+	}
+
+	SaveStateHeader header{};
+	std::memcpy(&header, buffer.data(), sizeof(header));
+	if (header.magic != SAVE_STATE_MAGIC)
+	{
+		return SaveStateResult::InvalidHeader;
+	}
+	if (header.version != SAVE_STATE_VERSION)
+	{
+		return SaveStateResult::VersionMismatch;
+	}
+
+	const SaveStateHeader expected = MakeSaveStateHeader();
+	if (header.mapperNumber != expected.mapperNumber ||
+		header.prgRomSize != expected.prgRomSize ||
+		header.chrSize != expected.chrSize ||
+		header.prgRamSize != expected.prgRamSize ||
+		header.stateSize != expected.stateSize)
+	{
+		return SaveStateResult::CartridgeMismatch;
+	}
+	if (buffer.size() < m_SaveStateSize)
+	{
+		return SaveStateResult::BufferTooSmall;
+	}
+
+	StateArchive state = StateArchive::ForLoad(buffer.subspan(sizeof(header)));
+	Serialize(state);
+
+	m_Mapper->UpdateCpuMemoryMap();
+	m_Mapper->UpdatePpuMemoryMap();
+	return SaveStateResult::Success;
+}
+
+u64 NES::GetStateHash()
+{
+	ASSERT(m_Mapper);
+
+	SyncPpu();
+	SyncApu();
+
+	StateArchive state = StateArchive::ForSave(m_HashState, true);
+	Serialize(state);
+
+	bool remapNeeded = false;
+	const Array<u64, 4> hashes = {
+		Hash::Hash64(m_HashState.data(), m_HashState.size()),
+		m_Wram.UpdateHash(remapNeeded),
+		m_Vram.UpdateHash(remapNeeded),
+		m_Cartridge.UpdateRamHash(remapNeeded)
+	};
+
+	// Pages just hashed are write-protected from here on, so the next
+	// write to each marks it dirty
+	if (remapNeeded)
+	{
+		RemapMemory();
+	}
+	return Hash::Hash64(hashes.data(), sizeof(hashes));
+}
+
+std::unique_ptr<NES> NES::Fork()
+{
+	auto child = std::make_unique<NES>();
+	ForkInto(*child);
+	return child;
+}
+
+void NES::ForkInto(NES& child)
+{
+	ASSERT(m_Mapper && &child != this);
+
+	// Same as saving, the PPU and APU have to stand where the CPU is
+	SyncPpu();
+	SyncApu();
+
+	if (child.m_Cartridge.GetImage() != m_Cartridge.GetImage())
+	{
+		// Can't fail, this instance runs the same mapper
+		[[maybe_unused]] const bool loaded = child.LoadROM(m_Cartridge.GetImage());
+		ASSERT(loaded);
+	}
+	child.m_SchedulerMode = m_SchedulerMode;
+	child.m_CpuExecutionMode = m_CpuExecutionMode;
+
+	StateArchive save = StateArchive::ForSave(m_ForkState, true);
+	Serialize(save);
+
+	child.m_Wram.ShareFrom(m_Wram);
+	child.m_Vram.ShareFrom(m_Vram);
+	child.m_Cartridge.ShareRam(m_Cartridge);
+
+	StateArchive load = StateArchive::ForLoad(m_ForkState, true);
+	child.Serialize(load);
+
+	// Shared pages aren't writable in place from either side
+	RemapMemory();
+	child.RemapMemory();
+}
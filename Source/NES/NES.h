@@ -1,15 +1,38 @@
 #pragma once
 
 #include "../Core/Common.h"
+#include "APU.h"
 #include "CPU.h"
 #include "CPUBus.h"
 #include "Cartridge.h"
+#include "CowMemory.h"
 #include "SystemCommon.h"
 #include "PPU.h"
 #include "HardwareController.h"
+#include "SaveState.h"
 
 #include <filesystem>
 #include <memory>
+#include <span>
+#include <vector>
+
+enum class SchedulerMode
+{
+	// PPU steps 3 dots after every CPU cycle
+	Lockstep,
+	// PPU only runs forward when the CPU touches it, a mapper register is
+	// written, or the PPU's next CPU-visible event is due
+	CatchUp
+};
+
+enum class CpuExecutionMode
+{
+	// CPU::PerformCycle every cycle
+	Cycle,
+	// CPU::ExecuteInstruction whenever no PPU event can land inside the
+	// instruction, per-cycle otherwise. Needs SchedulerMode::CatchUp.
+	Instruction
+};
 
 class NES
 {
@@ -17,30 +40,175 @@ public:
 	static constexpr double MASTER_CLOCK_PERIOD = 1.0 / (21.477272e6);
 	// Period between every CPU cycle
 	static constexpr double UPDATE_PERIOD = MASTER_CLOCK_PERIOD * 12.0;
-	static constexpr double FRAME_TIME = 1.0 / 60.0;
+	// 341 dots by 262 scanlines, 3 dots per CPU cycle, with the dot the
+	// pre-render line skips on every other frame while rendering is on
+	static constexpr double CPU_CYCLES_PER_FRAME = (341.0 * 262.0 - 0.5) / 3.0;
+	// About 1 / 60.0988 s
+	static constexpr double FRAME_TIME = UPDATE_PERIOD * CPU_CYCLES_PER_FRAME;
 
 	NES();
 
 	[[nodiscard]] bool LoadROM(const std::filesystem::path& path);
 
+	// Shares image with whoever else holds it, only the cartridge RAM is
+	// this instance's own. Fails only for an unsupported mapper.
+	[[nodiscard]] bool LoadROM(std::shared_ptr<const RomImage> image);
+
 	void Reset();
 
 	void StepFrame();
 
-	const u8* GetFramebuffer() const;
+	const u16* GetFramebuffer() const;
+
+	// Renders into a caller-owned SCREEN_WIDTH * SCREEN_HEIGHT buffer from
+	// now on, nullptr goes back to the internal one
+	void SetFramebuffer(u16* framebuffer) { m_Ppu.SetFramebufferTarget(framebuffer); }
+
+	// Turns framebuffer writes off for frames that won't be shown
+	void SetVideoOutput(bool enabled);
+
+	// Renders one frame in every skip + 1 and runs the others with video
+	// output off, which leaves out the background fetches, palette lookups
+	// and framebuffer writes. Sprite evaluation, sprite 0 hit, sprite
+	// overflow and VBlank happen exactly as on rendered frames, so the
+	// game can't tell. Only frames run with video output on count, so
+	// run-ahead's hidden frames don't shift the cadence.
+	void SetFrameSkip(u32 skip);
+
+	u32 GetFrameSkip() const { return m_FrameSkip; }
+
+	// Whether the last StepFrame wrote the framebuffer. After a skipped
+	// frame it still holds the last rendered one.
+	bool FrameRendered() const { return m_FrameRendered; }
 
 	// Cycles CPU once and PPU 3 times
 	void Update();
 
+	void SetSchedulerMode(SchedulerMode mode);
+
+	SchedulerMode GetSchedulerMode() const { return m_SchedulerMode; }
+
+	void SetCpuExecutionMode(CpuExecutionMode mode) { m_CpuExecutionMode = mode; }
+
+	CpuExecutionMode GetCpuExecutionMode() const { return m_CpuExecutionMode; }
+
 	void SetButtonsState(u8 state);
 
+	// Sound is synthesized at sampleRate from now on, 0 (the default)
+	// turns it off. The APU still runs for the game either way.
+	void SetAudioSampleRate(u32 sampleRate) { m_Apu.SetSampleRate(sampleRate); }
+
+	u32 GetAudioSampleRate() const { return m_Apu.GetSampleRate(); }
+
+	// Makes ratio times as many samples per second of emulated time as the
+	// sample rate says, for keeping a player's buffer level steady. Takes
+	// effect from the next frame.
+	void SetAudioRateRatio(double ratio) { m_Apu.SetRateRatio(ratio); }
+
+	// Turns sound synthesis off for frames whose sound won't be played
+	void SetAudioOutput(bool enabled) { m_Apu.SetOutputEnabled(enabled); }
+
+	// Mono i16 samples made by the frames stepped so far. About a quarter
+	// of a second is kept; older samples nobody read are dropped.
+	usize GetAudioSamplesAvailable() const { return m_Apu.GetSamplesAvailable(); }
+
+	usize ReadAudioSamples(std::span<i16> out) { return m_Apu.ReadSamples(out); }
+
+	// Save states have a fixed size for the loaded cartridge, known once
+	// LoadROM succeeds. Saving and loading copy straight between the
+	// components and the caller's buffer without allocating.
+	usize GetSaveStateSize() const { return m_SaveStateSize; }
+
+	SaveStateResult SaveState(std::span<u8> buffer);
+
+	SaveStateResult LoadState(std::span<const u8> buffer);
+
+	// 64-bit hash of everything SaveState writes after the header. Equal
+	// hashes mean the two runs would go on identically given the same
+	// input, which is what movie playback checks every frame.
+	// Incremental: the registers, OAM and palette are hashed every call,
+	// the RAM blocks only for the 1KB pages written since the last one.
+	// The value isn't a hash of the save state bytes themselves.
+	u64 GetStateHash();
+
+	// New instance in the same state as this one, for branching off and
+	// trying different inputs. The RAM blocks (WRAM, VRAM, PRG-RAM and
+	// CHR-RAM) are shared copy-on-write a 1KB page at a time, so a fork
+	// costs the registers plus whatever pages either side writes later.
+	// The framebuffer isn't copied; the child's fills in on its next frame.
+	std::unique_ptr<NES> Fork();
+
+	// Same as Fork, reusing child, which may hold a different game or an
+	// earlier fork. Saves the allocations when branching in a loop.
+	void ForkInto(NES& child);
+
+	// Bytes copied per fork, everything else is shared
+	usize GetForkStateSize() const { return m_ForkState.size(); }
+
+	// Direct component access for tooling (benchmarks, debuggers)
+	CPU& GetCpu() { return m_Cpu; }
+	PPU& GetPpu() { return m_Ppu; }
+	APU& GetApu() { return m_Apu; }
+	CPUBus& GetCpuBus() { return m_CpuBus; }
+	const Cartridge& GetCartridge() const { return m_Cartridge; }
+
+private:
+	// Cycles CPU once, PPU only when one of its events is due
+	void UpdateCatchUp();
+
+	// Runs a whole CPU instruction when it is safe to, otherwise one cycle
+	void UpdateInstruction();
+
+	void SyncPpu();
+
+	void SyncApu();
+
+	// Runs the APU up to the CPU if one of its IRQs is due
+	void CheckApuEvent()
+	{
+		const u64 cycle = m_Cpu.GetCycle();
+		if (cycle >= m_Apu.GetNextEventCycle())
+		{
+			m_Apu.CatchUp(cycle);
+		}
+	}
+
+	// Rebuilds every page table entry that points at RAM, after RAM pages
+	// became shared or private
+	void RemapMemory();
+
+	SaveStateHeader MakeSaveStateHeader() const;
+
+	// Components in save state order, after the header
+	void Serialize(StateArchive& state);
+
 private:
 	CPU m_Cpu{};
 	Cartridge m_Cartridge{};
 	PPU m_Ppu{};
+	APU m_Apu{};
 	CPUBus m_CpuBus{};
-	WRAM m_Wram{};
+	CowMemory m_Wram{};
+	CowMemory m_Vram{};
 	HardwareController m_Controller{};
 
 	std::unique_ptr<Mapper> m_Mapper{};
+
+	SchedulerMode m_SchedulerMode = SchedulerMode::CatchUp;
+	CpuExecutionMode m_CpuExecutionMode = CpuExecutionMode::Instruction;
+
+	bool m_VideoOutput = true;
+	u32 m_FrameSkip = 0;
+	// Frames left to skip before the next rendered one
+	u32 m_FramesToSkip = 0;
+	bool m_FrameRendered = false;
+
+	usize m_SaveStateSize = 0;
+
+	// Everything but the RAM blocks, which GetStateHash hashes page by page
+	std::vector<u8> m_HashState{};
+
+	// Everything but the shared RAM blocks, passed from parent to child
+	// through Serialize when forking
+	std::vector<u8> m_ForkState{};
 };
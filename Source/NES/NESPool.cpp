@@ -0,0 +1,74 @@
+#include "NESPool.h"
+
+#include "../Core/Logger.h"
+
+NESPool::NESPool(usize count, u32 threadCount) :
+	m_Slots{ std::make_unique<Slot[]>(count) },
+	m_Count{ count },
+	m_Pool{ threadCount }
+{
+
+}
+
+bool NESPool::LoadROM(const std::filesystem::path& path)
+{
+	std::shared_ptr<const RomImage> image;
+	if (RomImage::LoadFromFile(path, image) != CartridgeLoadResult::Success)
+	{
+		LOG_ERROR("NES pool failed to load ROM at %s", path.string().c_str());
+		return false;
+	}
+
+	for (usize i = 0; i < m_Count; i++)
+	{
+		if (!m_Slots[i].nes.LoadROM(image))
+		{
+			LOG_ERROR("NES pool can't run mapper %u", image->GetMapperNumber());
+			return false;
+		}
+	}
+	return true;
+}
+
+void NESPool::Reset()
+{
+	for (usize i = 0; i < m_Count; i++)
+	{
+		m_Slots[i].nes.Reset();
+	}
+}
+
+void NESPool::Step(std::span<const u8> actions, u16* framebuffers, u32 frames)
+{
+	ASSERT(actions.size() >= m_Count && frames > 0);
+
+	if (framebuffers != m_Framebuffers)
+	{
+		BindFramebuffers(framebuffers);
+	}
+
+	m_Pool.ParallelFor(m_Count, [&](usize i)
+	{
+		NES& nes = m_Slots[i].nes;
+		nes.SetButtonsState(actions[i]);
+		if (frames > 1)
+		{
+			nes.SetVideoOutput(false);
+			for (u32 frame = 1; frame < frames; frame++)
+			{
+				nes.StepFrame();
+			}
+			nes.SetVideoOutput(true);
+		}
+		nes.StepFrame();
+	});
+}
+
+void NESPool::BindFramebuffers(u16* framebuffers)
+{
+	for (usize i = 0; i < m_Count; i++)
+	{
+		m_Slots[i].nes.SetFramebuffer(framebuffers ? framebuffers + i * FRAME_PIXELS : nullptr);
+	}
+	m_Framebuffers = framebuffers;
+}
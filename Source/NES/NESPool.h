@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../Core/Common.h"
+#include "../Core/ThreadPool.h"
+#include "NES.h"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+
+// Batch of independent NES instances stepped together, one frame per
+// Step, across a thread pool. Meant for running many copies of a game at
+// once, e.g. as reinforcement learning environments.
+class NESPool
+{
+public:
+	static constexpr usize FRAME_PIXELS = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT;
+
+	// threadCount 0 uses every hardware thread
+	NESPool(usize count, u32 threadCount = 0);
+
+	// Loads the ROM once and shares it between every instance
+	[[nodiscard]] bool LoadROM(const std::filesystem::path& path);
+
+	void Reset();
+
+	// Sets instance i's controller to actions[i] and runs every instance
+	// frames frames, holding the action. Only the last frame is rendered,
+	// straight into framebuffers[i * FRAME_PIXELS], so framebuffers must
+	// hold GetCount() frames and stay valid until the next Step. The
+	// frames before it run with video off, see NES::SetVideoOutput.
+	void Step(std::span<const u8> actions, u16* framebuffers, u32 frames = 1);
+
+	usize GetCount() const { return m_Count; }
+
+	u32 GetThreadCount() const { return m_Pool.GetThreadCount(); }
+
+	NES& Get(usize index) { return m_Slots[index].nes; }
+
+private:
+	// Instances are laid out back to back, the padding keeps the end of
+	// one and the start of the next off a shared cache line
+	struct alignas(CACHE_LINE_SIZE) Slot
+	{
+		NES nes{};
+	};
+
+	void BindFramebuffers(u16* framebuffers);
+
+private:
+	std::unique_ptr<Slot[]> m_Slots{};
+	usize m_Count = 0;
+	u16* m_Framebuffers = nullptr;
+
+	ThreadPool m_Pool;
+};
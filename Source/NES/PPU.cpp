@@ -1,8 +1,13 @@
 #include "PPU.h"
 #include "Mapper.h"
 #include "CPU.h"
+#include "CowMemory.h"
+#include "SaveState.h"
 #include "../Core/Logger.h"
 
+#include <algorithm>
+#include <cstring>
+
 static constexpr u8 CTRL_SPRITE_TILE_SELECT_SHIFT = 3;
 static constexpr u8 CTRL_BACKGROUND_TILE_SELECT_SHIFT = 4;
 
@@ -54,11 +59,29 @@ static constexpr u16 PATTERN_TABLE_HALF_SHIFT = 12;
 
 static constexpr u16 SCANLINES_PER_FRAME = 262;
 static constexpr u16 POST_RENDER_START = 240;
+static constexpr u16 VBLANK_START_LINE = 241;
 static constexpr u16 DOTS_PER_SCANLINE = 341;
 static constexpr u16 PRERENDER_LINE = 261;
 
 static constexpr u16 SPRITE0_NONE = 0xFFFF;
 
+// Spreads the 8 bits of a pattern byte over the bytes of a u64, leftmost
+// pixel (bit 7) in the low byte
+static constexpr Array<u64, 256> MakePatternSpreadTable()
+{
+	Array<u64, 256> table{};
+	for (usize val = 0; val < table.size(); val++)
+	{
+		for (usize pixel = 0; pixel < 8; pixel++)
+		{
+			table[val] |= static_cast<u64>((val >> (7 - pixel)) & 1) << (pixel * 8);
+		}
+	}
+	return table;
+}
+
+static constexpr Array<u64, 256> PATTERN_SPREAD = MakePatternSpreadTable();
+
 // note: backdrop color can be overwritten if m_V points to palette RAM (3F00-3FFF)
 
 PPU::PPU() :
@@ -71,13 +94,16 @@ PPU::PPU(CPU* cpu, Mapper* mapper) :
 	m_Cpu {cpu},
 	m_Mapper{mapper}
 {
-	m_Framebuffer = std::make_unique<u8[]>(SCREEN_WIDTH * SCREEN_HEIGHT);
+	m_Framebuffer = std::make_unique<u16[]>(SCREEN_WIDTH * SCREEN_HEIGHT);
+	m_FramebufferTarget = m_Framebuffer.get();
 }
 
-void PPU::Attach(CPU* cpu, Mapper* mapper)
+void PPU::Attach(CPU* cpu, Mapper* mapper, CowMemory* vram)
 {
 	m_Cpu = cpu;
 	m_Mapper = mapper;
+	m_Vram = vram;
+	m_Mapper->ConnectPpu(this);
 }
 
 void PPU::PerformCycle()
@@ -100,6 +126,65 @@ void PPU::PerformCycle()
 	}
 
 	AdvanceCycle();
+	m_TotalDots++;
+}
+
+void PPU::CatchUp(u64 targetDot)
+{
+	if (m_TotalDots >= targetDot)
+	{
+		return;
+	}
+
+	while (m_TotalDots < targetDot)
+	{
+		// Nothing outside the PPU can touch it before targetDot, so a
+		// visible line that fits entirely can be rendered in one go
+		if (m_ScanlineCycle == 0 &&
+			m_Scanline < POST_RENDER_START &&
+			targetDot - m_TotalDots >= DOTS_PER_SCANLINE)
+		{
+			RenderScanline();
+		}
+		else
+		{
+			PerformCycle();
+		}
+	}
+
+	UpdateNextEventDot();
+}
+
+void PPU::SyncToCpu()
+{
+	CatchUp((m_Cpu->GetCycle() - 1) * DOTS_PER_CPU_CYCLE);
+}
+
+void PPU::UpdateNextEventDot()
+{
+	// Positions within the frame the PPU has to have passed for each event
+	// to have happened: framebuffer ready, VBlank set at dot 1, flags
+	// cleared at dot 1 of the pre-render line
+	static constexpr Array<u32, 3> EVENT_POSITIONS = {
+		POST_RENDER_START * DOTS_PER_SCANLINE,
+		VBLANK_START_LINE * DOTS_PER_SCANLINE + 2,
+		PRERENDER_LINE * DOTS_PER_SCANLINE + 2
+	};
+
+	const u32 position = m_Scanline * DOTS_PER_SCANLINE + m_ScanlineCycle;
+	for (const u32 eventPosition : EVENT_POSITIONS)
+	{
+		if (position < eventPosition)
+		{
+			m_NextEventDot = m_TotalDots + (eventPosition - position);
+			return;
+		}
+	}
+
+	// Wraps to the next frame. Assuming the short pre-render line of odd
+	// frames keeps this a lower bound.
+	const u32 frameDots = SCANLINES_PER_FRAME * DOTS_PER_SCANLINE - 1;
+	m_NextEventDot = m_TotalDots + (frameDots - position) + EVENT_POSITIONS[0];
 }
 
 void PPU::AdvanceCycle()
@@ -139,10 +224,85 @@ void PPU::Reset()
 	CPU* cpu = m_Cpu;
 	Mapper* mapper = m_Mapper;
 	auto framebuffer = std::move(m_Framebuffer);
+	u16* framebufferTarget = m_FramebufferTarget;
+	// Dot count keeps running so it stays in step with the CPU cycle count
+	const u64 totalDots = m_TotalDots;
+	// Page maps belong to the mapper
+	const auto chrReadPages = m_ChrReadPages;
+	const auto chrWritePages = m_ChrWritePages;
+	const auto nametableReadPages = m_NametableReadPages;
+	const auto nametableWritePages = m_NametableWritePages;
+	CowMemory* vram = m_Vram;
+	const bool outputEnabled = m_OutputEnabled;
 	std::memset(this, 0, sizeof(PPU));
 	m_Cpu = cpu;
 	m_Mapper = mapper;
 	m_Framebuffer = std::move(framebuffer);
+	m_FramebufferTarget = framebufferTarget;
+	m_TotalDots = totalDots;
+	m_ChrReadPages = chrReadPages;
+	m_ChrWritePages = chrWritePages;
+	m_NametableReadPages = nametableReadPages;
+	m_NametableWritePages = nametableWritePages;
+	m_Vram = vram;
+	m_OutputEnabled = outputEnabled;
+	// Cleared along with everything else, it just isn't stored inline
+	if (m_Vram)
+	{
+		m_Vram->Clear();
+	}
+	UpdateNextEventDot();
+}
+
+void PPU::Serialize(StateArchive& state)
+{
+	m_Vram->Serialize(state);
+	state.Value(m_Palette);
+	state.Value(m_Oam);
+	state.Value(m_SecondaryOam);
+
+	state.Value(m_CtrlReg);
+	state.Value(m_MaskReg);
+	state.Value(m_StatusReg);
+	state.Value(m_OamAddr);
+	state.Value(m_Scroll);
+
+	state.Value(m_V);
+	state.Value(m_T);
+	state.Value(m_X);
+	state.Value(m_W);
+
+	state.Value(m_NT);
+	state.Value(m_AT);
+	state.Value(m_BGLow);
+	state.Value(m_BGHigh);
+
+	state.Value(m_BGTileLowShift);
+	state.Value(m_BGTileHighShift);
+	state.Value(m_BGPaletteLowShift);
+	state.Value(m_BGPaletteHighShift);
+
+	state.Value(m_Sprite0InRange);
+	state.Value(m_SpritePixelBuf);
+
+	state.Value(m_ReadBuf);
+	state.Value(m_OpenBus);
+
+	state.Value(m_Scanline);
+	state.Value(m_ScanlineCycle);
+	state.Value(m_FrameNumber);
+
+	state.Value(m_TotalDots);
+
+	state.Value(m_FramebufferReady);
+
+	if (state.IsLoading())
+	{
+		m_TileRowsValid.fill(0);
+		// Only a scheduling hint, left stale in lockstep, so it isn't part
+		// of the state and two schedulers' states compare equal
+		UpdateNextEventDot();
+	}
 }
 
 void PPU::PrerenderCycle()
@@ -174,7 +334,7 @@ void PPU::PrerenderCycle()
 void PPU::VBlankCycle()
 {
 	// update vblank flag, trigger NMI
-	if (m_Scanline == 241 && m_ScanlineCycle == 1)
+	if (m_Scanline == VBLANK_START_LINE && m_ScanlineCycle == 1)
 	{
 		m_StatusReg |= STATUS_VBLANK_BIT;
 		if (m_CtrlReg & CTRL_NMI_ENABLE_BIT)
@@ -197,6 +357,208 @@ void PPU::VisibleCycle()
 	UpdateV();
 }
 
+// Same result as 341 calls to PerformCycle from dot 0 of a visible line:
+// framebuffer row, V, fetch latches, shift registers, sprite buffers and
+// status flags all end up identical. Only valid when no register access
+// or mapper write can land inside the line.
+void PPU::RenderScanline()
+{
+	const bool backgroundEnabled = m_MaskReg & MASK_BACKGROUND_ENABLE_BIT;
+	const bool spritesEnabled = m_MaskReg & MASK_SPRITE_ENABLE_BIT;
+	const bool renderingEnabled = RenderingEnabled();
+	const usize backgroundStart = (m_MaskReg & MASK_BACKGROUND_LEFT_COLUMN_ENABLE_BIT) ? 0 : 8;
+	const usize spriteStart = (m_MaskReg & MASK_SPRITE_LEFT_COLUMN_ENABLE_BIT) ? 0 : 8;
+
+	// Dots 1 and 65. Only sets flags and fills secondary OAM, which
+	// nothing reads before dot 257.
+	if (spritesEnabled)
+	{
+		m_SecondaryOam.fill(0xFF);
+		FillSecondaryOAM();
+	}
+
+	// Background pixels as (palette << 2) | color, starting m_X pixels
+	// left of the screen. The first 16 are the ones already in the shift
+	// registers, the rest are the tiles fetched on dots 1-256. Those
+	// fetches only feed the shift registers, which the two fetches on
+	// dots 321-336 overwrite completely, so they don't have to go through
+	// FetchTile.
+	Array<u8, SCREEN_WIDTH + 16> background{};
+
+	// With output off the pixels only matter for sprite 0 hit
+	const bool sprite0HitPossible =
+		backgroundEnabled && spritesEnabled &&
+		!(m_StatusReg & STATUS_SPRITE0_HIT_BIT) &&
+		std::any_of(m_SpritePixelBuf.begin(), m_SpritePixelBuf.end(),
+					[](SpritePixel sprite) { return sprite.sprite0Flag; });
+	const bool needPixels = m_OutputEnabled || sprite0HitPossible;
+	const bool fetchBackground = backgroundEnabled && needPixels;
+
+	if (fetchBackground)
+	{
+		for (usize i = 0; i < 16; i++)
+		{
+			const u16 bit = 15 - i;
+			background[i] = static_cast<u8>(
+				((m_BGTileLowShift >> bit) & 1) |
+				(((m_BGTileHighShift >> bit) & 1) << 1) |
+				(((m_BGPaletteLowShift >> bit) & 1) << 2) |
+				(((m_BGPaletteHighShift >> bit) & 1) << 3));
+		}
+	}
+
+	const u16 fineY = (m_V & INTERNAL_FINE_Y_SCROLL_MASK) >> INTERNAL_FINE_Y_SCROLL_SHIFT;
+	const u16 patternHalf = (m_CtrlReg & CTRL_BACKGROUND_TILE_SELECT_BIT) >> CTRL_BACKGROUND_TILE_SELECT_SHIFT;
+
+	for (usize tile = 0; tile < SCREEN_WIDTH / 8; tile++)
+	{
+		if (fetchBackground)
+		{
+			const u8 nt = NametableRead(m_V & 0x0FFF);
+			const u8 at = NametableRead(
+				0x3C0 | (m_V & 0x0C00) | ((m_V >> 4) & 0x38) | ((m_V >> 2) & 0x07)
+			);
+
+			const u8 coarseX = m_V & 0x1F;
+			const u8 coarseY = (m_V >> 5) & 0x1F;
+			const u8 shift = ((coarseY & 0x02) << 1) | (coarseX & 0x02);
+			const u64 paletteBits = (at >> shift) & 0b11;
+
+			const u64 pixels =
+				TileRow(fineY | (nt << PATTERN_TABLE_TILE_SHIFT) | (patternHalf << PATTERN_TABLE_HALF_SHIFT)) |
+				(paletteBits * 0x0404040404040404ull);
+
+			u8* dst = &background[16 + tile * 8];
+			for (usize i = 0; i < 8; i++)
+			{
+				dst[i] = static_cast<u8>(pixels >> (i * 8));
+			}
+		}
+		if (renderingEnabled)
+		{
+			IncHoriV();
+		}
+	}
+
+	if (renderingEnabled)
+	{
+		IncVertV();
+	}
+
+	u16* row = &m_FramebufferTarget[m_Scanline * SCREEN_WIDTH];
+	const u8* backgroundRow = &background[m_X];
+
+	for (usize x = 0; needPixels && x < SCREEN_WIDTH; x++)
+	{
+		const u8 backgroundPixels = x >= backgroundStart ? backgroundRow[x] : 0;
+
+		const SpritePixel sprite = m_SpritePixelBuf[x];
+		const u8 spritePixels = (spritesEnabled && x >= spriteStart) ? sprite.color : 0;
+
+		const bool opaqueSprite = spritePixels & 0b11;
+		const bool opaqueBackground = backgroundPixels & 0b11;
+
+		if (opaqueSprite && opaqueBackground && sprite.sprite0Flag)
+		{
+			m_StatusReg |= STATUS_SPRITE0_HIT_BIT;
+		}
+
+		if (!m_OutputEnabled)
+		{
+			continue;
+		}
+
+		u8 paletteAddr = 0;
+		if (!opaqueSprite && !opaqueBackground)
+		{
+			paletteAddr = 0;
+		}
+		else if (!opaqueBackground || (opaqueSprite && !sprite.priority))
+		{
+			paletteAddr = (1 << 4) | spritePixels;
+		}
+		else
+		{
+			paletteAddr = backgroundPixels;
+		}
+
+		row[x] = OutputPixel(paletteAddr);
+	}
+
+	// Dot 257. The background fetches from here to dot 320 are all
+	// overwritten by the ones below before anything reads them.
+	if (spritesEnabled)
+	{
+		FetchSpriteData();
+	}
+	if (renderingEnabled)
+	{
+		constexpr u16 mask =
+			INTERNAL_COARSE_X_SCROLL_MASK |
+			INTERNAL_NAMETABLE_X_MASK;
+		m_V &= ~mask;
+		m_V |= (m_T & mask);
+	}
+
+	// Dots 321-336, first two tiles of the next line
+	for (usize tile = 0; tile < 2; tile++)
+	{
+		if (backgroundEnabled)
+		{
+			FetchTile();
+		}
+		if (renderingEnabled)
+		{
+			IncHoriV();
+		}
+	}
+
+	// Dots 337 and 339, unused nametable fetches
+	if (backgroundEnabled)
+	{
+		m_NT = NametableRead(m_V & 0x0FFF);
+		m_AT = NametableRead(
+			0x3C0 | (m_V & 0x0C00) | ((m_V >> 4) & 0x38) | ((m_V >> 2) & 0x07)
+		);
+	}
+
+	m_Scanline++;
+	m_TotalDots += DOTS_PER_SCANLINE;
+	if (m_Scanline == POST_RENDER_START)
+	{
+		m_FramebufferReady = true;
+	}
+}
+
+void PPU::FetchTile()
+{
+	m_NT = NametableRead(m_V & 0x0FFF);
+	m_AT = NametableRead(
+		0x3C0 | (m_V & 0x0C00) | ((m_V >> 4) & 0x38) | ((m_V >> 2) & 0x07)
+	);
+
+	const u16 fineY = (m_V & INTERNAL_FINE_Y_SCROLL_MASK) >> INTERNAL_FINE_Y_SCROLL_SHIFT;
+	const u16 patternHalf = (m_CtrlReg & CTRL_BACKGROUND_TILE_SELECT_BIT) >> CTRL_BACKGROUND_TILE_SELECT_SHIFT;
+	const u16 addr =
+		fineY |
+		(m_NT << PATTERN_TABLE_TILE_SHIFT) |
+		(patternHalf << PATTERN_TABLE_HALF_SHIFT);
+	m_BGLow = ChrRead(addr);
+	m_BGHigh = ChrRead(addr | (1 << PATTERN_TABLE_BIT_PLANE_SHIFT));
+
+	const u8 coarseX = m_V & 0x1F;
+	const u8 coarseY = (m_V >> 5) & 0x1F;
+	const u8 shift = ((coarseY & 0x02) << 1) | (coarseX & 0x02);
+	const u8 paletteBits = (m_AT >> shift) & 0b11;
+	const u8 expandedLow = (paletteBits & 1) ? 0xFF : 0x00;
+	const u8 expandedHigh = (paletteBits & 2) ? 0xFF : 0x00;
+
+	m_BGTileLowShift = (m_BGTileLowShift << 8) | m_BGLow;
+	m_BGTileHighShift = (m_BGTileHighShift << 8) | m_BGHigh;
+	m_BGPaletteLowShift = (m_BGPaletteLowShift << 8) | expandedLow;
+	m_BGPaletteHighShift = (m_BGPaletteHighShift << 8) | expandedHigh;
+}
+
 void PPU::SetPixel()
 {
 	if (m_ScanlineCycle > 256)
@@ -207,6 +569,12 @@ void PPU::SetPixel()
 	const usize y = m_Scanline;
 	const usize x = m_ScanlineCycle - 1;
 
+	// With output off the pixel only matters for sprite 0 hit
+	if (!m_OutputEnabled && !m_SpritePixelBuf[x].sprite0Flag)
+	{
+		return;
+	}
+
 	u8 backgroundPixels = 0;
 
 	if ((m_MaskReg & MASK_BACKGROUND_ENABLE_BIT) && 
@@ -244,6 +612,11 @@ void PPU::SetPixel()
 		m_StatusReg |= STATUS_SPRITE0_HIT_BIT;
 	}
 
+	if (!m_OutputEnabled)
+	{
+		return;
+	}
+
 	// both transparent, choose backdrop
 
 	if (!opaqueSprite && !opaqueBackground)
@@ -259,7 +632,14 @@ void PPU::SetPixel()
 		paletteAddr = backgroundPixels;
 	}
 
-	m_Framebuffer[y * SCREEN_WIDTH + x] = PaletteRead(paletteAddr);
+	m_FramebufferTarget[y * SCREEN_WIDTH + x] = OutputPixel(paletteAddr);
+}
+
+u16 PPU::OutputPixel(u16 paletteAddr)
+{
+	const u8 greyscaleMask = (m_MaskReg & MASK_GREYSCALE_BIT) ? 0x30 : 0x3F;
+	const u16 emphasis = (m_MaskReg & MASK_COLOR_EMPHASIS_MASK) >> 5;
+	return (PaletteRead(paletteAddr) & greyscaleMask) | (emphasis << PIXEL_EMPHASIS_SHIFT);
 }
 
 void PPU::ShiftRegisters()
@@ -326,7 +706,7 @@ void PPU::FetchBackgroundData()
 			fineY |
 			(tileNumber << PATTERN_TABLE_TILE_SHIFT) |
 			(patternHalf << PATTERN_TABLE_HALF_SHIFT);
-		m_BGLow = *m_Mapper->PpuRead(addr);
+		m_BGLow = ChrRead(addr);
 		break;
 	}
 	// BG msbits fetch
@@ -339,7 +719,7 @@ void PPU::FetchBackgroundData()
 			(1 << PATTERN_TABLE_BIT_PLANE_SHIFT) | // read from right bitplane instead of left
 			(tileNumber << PATTERN_TABLE_TILE_SHIFT) |
 			(patternHalf << PATTERN_TABLE_HALF_SHIFT);
-		m_BGHigh = *m_Mapper->PpuRead(addr);
+		m_BGHigh = ChrRead(addr);
 		break;
 	}
 	default:
@@ -455,16 +835,12 @@ void PPU::FetchSpriteData()
 			}
 		}
 
-		const u16 addrLow =
+		const u16 addr =
 			fineY |
 			(tileNum << PATTERN_TABLE_TILE_SHIFT) |
 			(patternHalf << PATTERN_TABLE_HALF_SHIFT);
 
-		const u16 addrHigh =
-			addrLow | (1 << PATTERN_TABLE_BIT_PLANE_SHIFT);
-
-		const u8 patternLow = *m_Mapper->PpuRead(addrLow);
-		const u8 patternHigh = *m_Mapper->PpuRead(addrHigh);
+		const u64 pattern = TileRow(addr);
 
 		const u8 paletteBits = sprite.attributes & SPRITE_ATTRIBUTE_PALETTE_MASK;
 		const u8 priority = (sprite.attributes >> SPRITE_ATTRIBUTE_PRIORITY_SHIFT) & 1;
@@ -472,15 +848,13 @@ void PPU::FetchSpriteData()
 		for (u8 dx = 0; dx < 8; dx++)
 		{
 			const u8 fineX = flipHorizontal ? 7 - dx : dx;
-			const u8 bitIndex = 7 - fineX;
 			const u16 lineX = sprite.xPos + dx;
 			if (lineX >= SCREEN_WIDTH)
 			{
 				break;
 			}
 			const u8 color =
-				((patternLow >> bitIndex) & 1) |
-				(((patternHigh >> bitIndex) & 1) << 1) |
+				((pattern >> (fineX * 8)) & 0b11) |
 				(paletteBits << 2);
 			// take only first opaque pixels
 			const bool sprite0Flag = m_Sprite0InRange && i == 0;
@@ -762,7 +1136,7 @@ u8 PPU::Read(u16 addr)
 {
 	if (addr < 0x2000)
 	{
-		return *m_Mapper->PpuRead(addr);
+		return ChrRead(addr);
 	}
 	else if (addr < 0x3F00)
 	{
@@ -780,7 +1154,7 @@ void PPU::Write(u16 addr, u8 val)
 {
 	if (addr < 0x2000)
 	{
-		m_Mapper->PpuWrite(addr, val);
+		ChrWrite(addr, val);
 		return;
 	}
 	else if (addr < 0x3F00)
@@ -796,12 +1170,76 @@ void PPU::Write(u16 addr, u8 val)
 	}
 }
 
+void PPU::ChrWrite(u16 addr, u8 val)
+{
+	InvalidateTile(addr);
+
+	if (u8* page = m_ChrWritePages[addr >> PAGE_SHIFT])
+	{
+		page[addr & PAGE_MASK] = val;
+		return;
+	}
+	m_Mapper->PpuWrite(addr, val);
+}
+
+u64 PPU::DecodeTile(u16 addr)
+{
+	const u16 slot = addr >> PAGE_SHIFT;
+	const u16 tile = (addr & PAGE_MASK) >> PATTERN_TABLE_TILE_SHIFT;
+	const u16 fineY = addr & 0x7;
+	const u8* page = m_ChrReadPages[slot];
+
+	// Unmapped pages read through the mapper, which may watch the fetches,
+	// so only the requested row is read and nothing is kept
+	if (!page)
+	{
+		return PATTERN_SPREAD[ChrRead(addr)] |
+			(PATTERN_SPREAD[ChrRead(addr | (1 << PATTERN_TABLE_BIT_PLANE_SHIFT))] << 1);
+	}
+
+	const u8* pattern = page + (tile << PATTERN_TABLE_TILE_SHIFT);
+	u64* rows = &m_TileRows[slot][tile * 8];
+	for (usize y = 0; y < 8; y++)
+	{
+		rows[y] = PATTERN_SPREAD[pattern[y]] | (PATTERN_SPREAD[pattern[y + 8]] << 1);
+	}
+	m_TileRowsValid[slot] |= 1ull << tile;
+
+	return rows[fineY];
+}
+
+void PPU::InvalidateTile(u16 addr)
+{
+	// The same CHR page can be mapped into several slots (MMC1 with both
+	// 4KB banks pointing at the same memory), so clear the tile in all of
+	// them. Pages are never mapped at an offset within another page.
+	const u8* page = m_ChrReadPages[addr >> PAGE_SHIFT];
+	if (!page)
+	{
+		return;
+	}
+
+	const u64 keep = ~(1ull << ((addr & PAGE_MASK) >> PATTERN_TABLE_TILE_SHIFT));
+	for (usize slot = 0; slot < m_ChrReadPages.size(); slot++)
+	{
+		if (m_ChrReadPages[slot] == page)
+		{
+			m_TileRowsValid[slot] &= keep;
+		}
+	}
+}
+
 u8 PPU::NametableRead(u16 offset)
 {
+	if (const u8* page = m_NametableReadPages[(offset >> PAGE_SHIFT) & 0x3])
+	{
+		return page[offset & PAGE_MASK];
+	}
+
 	const std::optional<u16> mirrored = m_Mapper->NametableMirror(offset);
 	if (mirrored)
 	{
-		return m_Vram[*mirrored];
+		return m_Vram->Read(*mirrored);
 	}
 	else
 	{
@@ -811,10 +1249,16 @@ u8 PPU::NametableRead(u16 offset)
 
 void PPU::NametableWrite(u16 offset, u8 val)
 {
+	if (u8* page = m_NametableWritePages[(offset >> PAGE_SHIFT) & 0x3])
+	{
+		page[offset & PAGE_MASK] = val;
+		return;
+	}
+
 	const std::optional<u16> mirrored = m_Mapper->NametableMirror(offset);
 	if (mirrored)
 	{
-		m_Vram[*mirrored] = val;
+		m_Vram->Write(*mirrored, val);
 	}
 	else
 	{
@@ -2,32 +2,68 @@
 
 #include "../Core/Common.h"
 #include "Mapper.h"
+#include "SystemCommon.h"
 #include <bitset>
 
 class Cartridge;
+class CowMemory;
 class CPU;
+class StateArchive;
 
 class PPU
 {
 public:
 	static constexpr u16 SCREEN_WIDTH = 256;
 	static constexpr u16 SCREEN_HEIGHT = 240;
+	static constexpr u64 DOTS_PER_CPU_CYCLE = 3;
+
+	// Pattern tables and nametables are mapped in 1KB pages, maintained
+	// by the mapper. Null pages go through Mapper::PpuRead/PpuWrite.
+	static constexpr u16 PAGE_SHIFT = 10;
+	static constexpr u16 PAGE_SIZE = 1 << PAGE_SHIFT;
+	static constexpr u16 PAGE_MASK = PAGE_SIZE - 1;
 
 	PPU();
 
 	PPU(CPU* cpu, Mapper* mapper);
 
-	void Attach(CPU* cpu, Mapper* mapper);
+	// vram is the 2KB of nametable RAM, owned by the NES so forks can
+	// share it
+	void Attach(CPU* cpu, Mapper* mapper, CowMemory* vram);
 
 	void Reset();
 
 	void PerformCycle();
 
+	// Runs the PPU forward until it has performed targetDot dots in total
+	void CatchUp(u64 targetDot);
+
+	// Catches up to the start of the CPU cycle currently executing, which is
+	// the state a bus access would see if the PPU ran in lockstep
+	void SyncToCpu();
+
+	u64 GetTotalDots() const { return m_TotalDots; }
+
+	// Lower bound on the dot count at which the PPU next changes state the
+	// CPU can observe without touching a PPU register (VBlank/NMI, the
+	// pre-render flag clear, end of frame)
+	u64 GetNextEventDot() const { return m_NextEventDot; }
+
 	bool FramebufferReady() const { return m_FramebufferReady; }
 
 	void ClearFramebufferReady() { m_FramebufferReady = false; }
 
-	const u8* GetFramebuffer() const { return m_Framebuffer.get(); }
+	const u16* GetFramebuffer() const { return m_FramebufferTarget; }
+
+	// Renders into target, which must hold SCREEN_WIDTH * SCREEN_HEIGHT
+	// pixels, instead of the PPU's own framebuffer. nullptr goes back to it.
+	void SetFramebufferTarget(u16* target) { m_FramebufferTarget = target ? target : m_Framebuffer.get(); }
+
+	// With output off nothing is written to the framebuffer, for frames
+	// that are emulated but never shown. Sprite 0 hit still works.
+	void SetOutputEnabled(bool enabled) { m_OutputEnabled = enabled; }
+
+	bool OutputEnabled() const { return m_OutputEnabled; }
 
 	void SetCtrl(u8 data);
 
@@ -54,7 +90,60 @@ public:
 
 	void DirectOAMWrite(u8 data);
 
+	void MapChrPage(u16 addr, const u8* read, u8* write)
+	{
+		const u16 slot = addr >> PAGE_SHIFT;
+		if (m_ChrReadPages[slot] != read)
+		{
+			m_TileRowsValid[slot] = 0;
+		}
+		m_ChrReadPages[slot] = read;
+		m_ChrWritePages[slot] = write;
+	}
+
+	// offset is relative to $2000
+	void MapNametablePage(u16 offset, const u8* read, u8* write)
+	{
+		m_NametableReadPages[(offset >> PAGE_SHIFT) & 0x3] = read;
+		m_NametableWritePages[(offset >> PAGE_SHIFT) & 0x3] = write;
+	}
+
+	CowMemory& GetVram() { return *m_Vram; }
+
+	// Everything but the framebuffer and the page maps, which the mapper
+	// rebuilds. Loading drops the decoded tile cache since CHR-RAM may
+	// have changed underneath it.
+	void Serialize(StateArchive& state);
+
 private:
+	u8 ChrRead(u16 addr)
+	{
+		if (const u8* page = m_ChrReadPages[addr >> PAGE_SHIFT])
+		{
+			return page[addr & PAGE_MASK];
+		}
+		return *m_Mapper->PpuRead(addr);
+	}
+
+	void ChrWrite(u16 addr, u8 val);
+
+	// Both bit planes of the pattern row at addr (plane 0 address) decoded
+	// to one byte per pixel, leftmost pixel in the low byte
+	u64 TileRow(u16 addr)
+	{
+		const u16 slot = addr >> PAGE_SHIFT;
+		const u16 tile = (addr & PAGE_MASK) >> 4;
+		if (!((m_TileRowsValid[slot] >> tile) & 1))
+		{
+			return DecodeTile(addr);
+		}
+		return m_TileRows[slot][tile * 8 + (addr & 0x7)];
+	}
+
+	u64 DecodeTile(u16 addr);
+
+	void InvalidateTile(u16 addr);
+
 	u8 Read(u16 addr);
 
 	void Write(u16 addr, u8 val);
@@ -73,6 +162,13 @@ private:
 
 	void VisibleCycle();
 
+	// Runs a whole visible scanline from dot 0, see PPU.cpp
+	void RenderScanline();
+
+	// Fetches one background tile and reloads the shift registers as
+	// they stand after that tile's 8 dots
+	void FetchTile();
+
 	void FetchBackgroundData();
 
 	void EvaluateSprites();
@@ -89,8 +185,14 @@ private:
 
 	void AdvanceCycle();
 
+	void UpdateNextEventDot();
+
 	void SetPixel();
 
+	// Palette RAM value for paletteAddr with greyscale and emphasis from
+	// PPUMASK applied, as stored in the framebuffer
+	u16 OutputPixel(u16 paletteAddr);
+
 	void ShiftRegisters();
 
 	void IncHoriV();
@@ -116,15 +218,27 @@ private:
 		u8 unused : 2;
 	};
 
-	Memory<0x800> m_Vram{};
+	CowMemory* m_Vram = nullptr;
 	Memory<0x20> m_Palette{};
 	Memory<0x100> m_Oam{};
 	Memory<0x20> m_SecondaryOam{};
 
-	std::unique_ptr<u8[]> m_Framebuffer = nullptr;
+	std::unique_ptr<u16[]> m_Framebuffer = nullptr;
+	// Where pixels are written, m_Framebuffer unless the owner supplied one
+	u16* m_FramebufferTarget = nullptr;
 	CPU* m_Cpu = nullptr;
 	Mapper* m_Mapper = nullptr;
 
+	Array<const u8*, 8> m_ChrReadPages{};
+	Array<u8*, 8> m_ChrWritePages{};
+	Array<const u8*, 4> m_NametableReadPages{};
+	Array<u8*, 4> m_NametableWritePages{};
+
+	// Decoded rows for the 64 tiles of each CHR page, with a bit per tile
+	// that is cleared when the page is remapped or the tile written
+	Array<Array<u64, 64 * 8>, 8> m_TileRows{};
+	Array<u64, 8> m_TileRowsValid{};
+
 	// I/O registers
 	u8 m_CtrlReg = 0;
 	u8 m_MaskReg = 0;
@@ -161,5 +275,10 @@ private:
 	u16 m_ScanlineCycle = 0;
 	u64 m_FrameNumber = 0;
 
+	u64 m_TotalDots = 0;
+	u64 m_NextEventDot = 0;
+
 	bool m_FramebufferReady = false;
+
+	bool m_OutputEnabled = true;
 };
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "RewindBuffer.h"
+#include "NES.h"
+#include "../Core/Compression.h"
+#include "../Core/Logger.h"
+
+#include <cstring>
+
+// Word at a time, a byte loop is several times slower at -O2
+static void XorInto(u8* dst, const u8* src, usize size)
+{
+	usize i = 0;
+	for (; i + sizeof(u64) <= size; i += sizeof(u64))
+	{
+		u64 a;
+		u64 b;
+		std::memcpy(&a, dst + i, sizeof(a));
+		std::memcpy(&b, src + i, sizeof(b));
+		a ^= b;
+		std::memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < size; i++)
+	{
+		dst[i] ^= src[i];
+	}
+}
+
+RewindBuffer::RewindBuffer(usize stateSize, const RewindConfig& config) :
+	m_Config{ config },
+	m_StateSize{ stateSize }
+{
+	const usize maxSnapshots = static_cast<usize>(config.seconds / NES::FRAME_TIME);
+	m_Storage.resize(config.memoryBudget);
+	m_Snapshots.resize(maxSnapshots ? maxSnapshots : 1);
+	m_Keyframe.resize(stateSize);
+	m_State.resize(stateSize);
+	m_Compressed.resize(Compression::GetCompressBound(stateSize));
+}
+
+void RewindBuffer::Clear()
+{
+	m_Head = 0;
+	m_BytesUsed = 0;
+	m_First = 0;
+	m_Count = 0;
+	m_KeyframeValid = false;
+	m_SinceKeyframe = 0;
+}
+
+bool RewindBuffer::Push(NES& nes)
+{
+	if (nes.SaveState(m_State) != SaveStateResult::Success)
+	{
+		return false;
+	}
+
+	const bool keyframe = !m_KeyframeValid || m_Count == 0 || m_SinceKeyframe >= m_Config.keyframeInterval;
+	if (keyframe)
+	{
+		std::memcpy(m_Keyframe.data(), m_State.data(), m_StateSize);
+		m_KeyframeValid = true;
+		return Store(true);
+	}
+
+	XorInto(m_State.data(), m_Keyframe.data(), m_StateSize);
+	if (Store(false))
+	{
+		return true;
+	}
+
+	// Making room dropped the keyframe this delta is against, so the state
+	// starts a group of its own and later deltas go against it
+	XorInto(m_State.data(), m_Keyframe.data(), m_StateSize);
+	std::memcpy(m_Keyframe.data(), m_State.data(), m_StateSize);
+	return Store(true);
+}
+
+bool RewindBuffer::Store(bool keyframe)
+{
+	const usize size = Compression::Compress(m_State.data(), m_StateSize, m_Compressed.data(), m_Compressed.size());
+	if (!size)
+	{
+		return false;
+	}
+
+	if (m_Count == m_Snapshots.size())
+	{
+		DropOldest();
+	}
+
+	usize offset = 0;
+	if (!Allocate(size, offset))
+	{
+		if (!m_BudgetWarned)
+		{
+			LOG_WARN("Rewind budget of %zu bytes can't hold a %zu byte snapshot", m_Storage.size(), size);
+			m_BudgetWarned = true;
+		}
+		Clear();
+		return false;
+	}
+	if (!keyframe && m_Count == 0)
+	{
+		return false;
+	}
+
+	std::memcpy(&m_Storage[offset], m_Compressed.data(), size);
+	m_Head = offset + size;
+	m_BytesUsed += size;
+
+	m_Count++;
+	At(m_Count - 1) = { .offset = offset, .size = size, .keyframe = keyframe };
+
+	if (keyframe)
+	{
+		m_SinceKeyframe = 1;
+		m_KeyframeBytes += size;
+		m_KeyframesPushed++;
+	}
+	else
+	{
+		m_SinceKeyframe++;
+		m_DeltaBytes += size;
+		m_DeltasPushed++;
+	}
+	return true;
+}
+
+bool RewindBuffer::Rewind(NES& nes)
+{
+	if (m_Count == 0)
+	{
+		return false;
+	}
+
+	const Snapshot snapshot = At(m_Count - 1);
+	if (!Decode(snapshot, m_State.data()))
+	{
+		LOG_ERROR("Corrupt rewind snapshot, clearing %zu snapshots", m_Count);
+		Clear();
+		return false;
+	}
+
+	m_Count--;
+	m_BytesUsed -= snapshot.size;
+	m_Head = snapshot.offset;
+
+	if (!snapshot.keyframe)
+	{
+		m_SinceKeyframe--;
+	}
+	else
+	{
+		// The previous group's keyframe becomes the one deltas decode against
+		m_KeyframeValid = false;
+		for (usize i = m_Count; i-- > 0;)
+		{
+			if (At(i).keyframe)
+			{
+				m_KeyframeValid = Decode(At(i), m_Keyframe.data());
+				m_SinceKeyframe = static_cast<u32>(m_Count - i);
+				break;
+			}
+		}
+	}
+
+	return nes.LoadState(m_State) == SaveStateResult::Success;
+}
+
+bool RewindBuffer::Decode(const Snapshot& snapshot, u8* dst) const
+{
+	if (!Compression::Decompress(&m_Storage[snapshot.offset], snapshot.size, dst, m_StateSize))
+	{
+		return false;
+	}
+	if (!snapshot.keyframe)
+	{
+		XorInto(dst, m_Keyframe.data(), m_StateSize);
+	}
+	return true;
+}
+
+bool RewindBuffer::Allocate(usize size, usize& offset)
+{
+	if (size > m_Storage.size())
+	{
+		return false;
+	}
+
+	usize start = m_Head;
+	if (start + size > m_Storage.size())
+	{
+		// Whatever sits between the head and the end is older than
+		// anything at the start of the ring, so it goes first
+		while (m_Count && At(0).offset >= m_Head)
+		{
+			DropOldest();
+		}
+		start = 0;
+	}
+
+	while (m_Count && At(0).offset < start + size && At(0).offset + At(0).size > start)
+	{
+		DropOldest();
+	}
+
+	offset = start;
+	return true;
+}
+
+void RewindBuffer::DropOldest()
+{
+	// A keyframe takes the deltas against it along
+	do
+	{
+		m_BytesUsed -= At(0).size;
+		m_First = (m_First + 1) % m_Snapshots.size();
+		m_Count--;
+	} while (m_Count && !At(0).keyframe);
+}
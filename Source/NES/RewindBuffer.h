@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <vector>
+
+class NES;
+
+struct RewindConfig
+{
+	// How far back rewinding can go, at one snapshot per frame
+	u32 seconds = 30;
+	// Upper bound on the compressed snapshot storage
+	usize memoryBudget = 16 << 20;
+	// A full state is kept every this many snapshots, the rest are stored
+	// as the XOR against it
+	u32 keyframeInterval = 60;
+};
+
+// Per-frame snapshot history of one NES. Snapshots are LZ compressed into
+// a ring of memoryBudget bytes allocated up front; the oldest keyframe
+// group is dropped when either the ring or the frame count runs out.
+class RewindBuffer
+{
+public:
+	RewindBuffer(usize stateSize, const RewindConfig& config = {});
+
+	// Call before each NES::StepFrame. Returns false if the snapshot
+	// couldn't be taken, which only happens when the budget is smaller
+	// than a single compressed state.
+	bool Push(NES& nes);
+
+	// Loads the most recent snapshot into nes and forgets it, so calling
+	// this then StepFrame repeatedly plays the history backwards one
+	// frame at a time. Returns false when there is nothing left.
+	bool Rewind(NES& nes);
+
+	void Clear();
+
+	usize GetSnapshotCount() const { return m_Count; }
+
+	// Compressed bytes held by live snapshots
+	usize GetMemoryUsed() const { return m_BytesUsed; }
+
+	usize GetCapacity() const { return m_Storage.size(); }
+
+	u64 GetKeyframeBytes() const { return m_KeyframeBytes; }
+	u64 GetKeyframesPushed() const { return m_KeyframesPushed; }
+	u64 GetDeltaBytes() const { return m_DeltaBytes; }
+	u64 GetDeltasPushed() const { return m_DeltasPushed; }
+
+private:
+	struct Snapshot
+	{
+		usize offset = 0;
+		usize size = 0;
+		bool keyframe = false;
+	};
+
+	// Finds room for size bytes in the ring, dropping old groups as needed
+	bool Allocate(usize size, usize& offset);
+
+	void DropOldest();
+
+	Snapshot& At(usize index) { return m_Snapshots[(m_First + index) % m_Snapshots.size()]; }
+
+	bool Decode(const Snapshot& snapshot, u8* dst) const;
+
+	bool Store(bool keyframe);
+
+private:
+	RewindConfig m_Config{};
+	usize m_StateSize = 0;
+
+	std::vector<u8> m_Storage{};
+	usize m_Head = 0;
+	usize m_BytesUsed = 0;
+
+	// Ring of snapshot records, oldest at m_First
+	std::vector<Snapshot> m_Snapshots{};
+	usize m_First = 0;
+	usize m_Count = 0;
+
+	// Raw state of the newest group's keyframe, what deltas are XORed with
+	std::vector<u8> m_Keyframe{};
+	bool m_KeyframeValid = false;
+	u32 m_SinceKeyframe = 0;
+
+	std::vector<u8> m_State{};
+	std::vector<u8> m_Compressed{};
+
+	bool m_BudgetWarned = false;
+
+	u64 m_KeyframeBytes = 0;
+	u64 m_KeyframesPushed = 0;
+	u64 m_DeltaBytes = 0;
+	u64 m_DeltasPushed = 0;
+};
@@ -0,0 +1,118 @@
+#include "RomImage.h"
+
+#include <cstring>
+#include <fstream>
+
+CartridgeLoadResult RomImage::LoadFromFile(const std::filesystem::path& path, std::shared_ptr<const RomImage>& image,
+										   RomLoadMode mode)
+{
+	if (mode == RomLoadMode::Mapped)
+	{
+		auto mapped = std::make_shared<RomImage>();
+		if (mapped->m_Mapping.Open(path))
+		{
+			// A bad header stays bad when copied, no point falling back
+			const CartridgeLoadResult result = mapped->Parse(mapped->m_Mapping.GetData(), mapped->m_Mapping.GetSize());
+			if (result == CartridgeLoadResult::Success)
+			{
+				image = std::move(mapped);
+			}
+			return result;
+		}
+	}
+
+	std::ifstream inf{ path, std::ios::binary | std::ios::ate };
+
+	if (!inf)
+	{
+		return CartridgeLoadResult::FileNotFound;
+	}
+
+	const std::streamoff fileSize = inf.tellg();
+	if (fileSize < static_cast<std::streamoff>(HEADER_SIZE))
+	{
+		return CartridgeLoadResult::InvalidHeader;
+	}
+	inf.seekg(0);
+
+	auto loaded = std::make_shared<RomImage>();
+	loaded->m_Data = std::make_unique<u8[]>(fileSize);
+	if (!inf.read(reinterpret_cast<char*>(loaded->m_Data.get()), fileSize))
+	{
+		return CartridgeLoadResult::MissingData;
+	}
+
+	const CartridgeLoadResult result = loaded->Parse(loaded->m_Data.get(), fileSize);
+	if (result == CartridgeLoadResult::Success)
+	{
+		image = std::move(loaded);
+	}
+	return result;
+}
+
+CartridgeLoadResult RomImage::Parse(const u8* data, usize size)
+{
+	const char expectedHeader[4] = { 'N', 'E', 'S', '\x1A' };
+
+	const u8* header = data;
+	if (size < HEADER_SIZE || std::memcmp(header, expectedHeader, 4) != 0)
+	{
+		return CartridgeLoadResult::InvalidHeader;
+	}
+
+	m_PrgRomSize = header[4] * 0x4000;
+	if (m_PrgRomSize == 0)
+	{
+		return CartridgeLoadResult::InvalidPrgRomSize;
+	}
+
+	// 0 CHR-ROM banks means 8KB of CHR-RAM
+	const bool hasChrRom = header[5] != 0;
+	m_ChrSize = hasChrRom ? header[5] * 0x2000 : 0x2000;
+
+	if (header[6] & (1 << 0))
+	{
+		m_MirrorMode = MirrorMode::Vertical;
+	}
+	else
+	{
+		m_MirrorMode = MirrorMode::Horizontal;
+	}
+
+	m_HasPrgRam = header[6] & (1 << 1);
+	const bool hasTrainer = header[6] & (1 << 2);
+	if (header[6] & (1 << 3))
+	{
+		m_MirrorMode = MirrorMode::FourScreen;
+	}
+	m_MapperNumber = (header[6] >> 4) | (header[7] & 0xF0);
+
+	m_PrgRamSize = header[8] * 0x2000;
+	if (m_HasPrgRam && m_PrgRamSize == 0)
+	{
+		m_PrgRamSize = 0x8000u;
+	}
+
+	usize offset = HEADER_SIZE;
+	if (hasTrainer)
+	{
+		m_Trainer = data + offset;
+		offset += TRAINER_SIZE;
+	}
+
+	m_PrgRom = data + offset;
+	offset += m_PrgRomSize;
+
+	if (hasChrRom)
+	{
+		m_ChrRom = data + offset;
+		offset += m_ChrSize;
+	}
+
+	if (offset > size)
+	{
+		return CartridgeLoadResult::MissingData;
+	}
+
+	return CartridgeLoadResult::Success;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../Core/Common.h"
+#include "../Core/MappedFile.h"
+
+#include <filesystem>
+#include <memory>
+
+enum class MirrorMode : u8
+{
+	Horizontal,
+	Vertical,
+	SingleScreenLower,
+	SingleScreenUpper,
+	FourScreen
+};
+
+enum class CartridgeLoadResult
+{
+	Success = 0,
+	FileNotFound,
+	InvalidHeader,
+	InvalidPrgRomSize,
+	MissingData
+};
+
+enum class RomLoadMode
+{
+	// Maps the file and uses it in place, reading it into memory instead
+	// when it can't be mapped
+	Mapped,
+	// Always reads the file into memory
+	Copy
+};
+
+// The read-only part of an iNES file: header fields, PRG-ROM, CHR-ROM and
+// the trainer. Never changes once loaded, so any number of Cartridges can
+// share one through a shared_ptr and only allocate their own RAM.
+class RomImage
+{
+public:
+	static constexpr usize HEADER_SIZE = 16;
+	static constexpr usize TRAINER_SIZE = 0x200;
+
+	[[nodiscard]] static CartridgeLoadResult LoadFromFile(const std::filesystem::path& path,
+														  std::shared_ptr<const RomImage>& image,
+														  RomLoadMode mode = RomLoadMode::Mapped);
+
+	const u8* GetPrgRom() const { return m_PrgRom; }
+
+	usize GetPrgRomSize() const { return m_PrgRomSize; }
+
+	// nullptr when the cartridge has CHR-RAM instead
+	const u8* GetChrRom() const { return m_ChrRom; }
+
+	// Size of CHR-ROM, or of the CHR-RAM the cartridge needs
+	usize GetChrSize() const { return m_ChrSize; }
+
+	usize GetPrgRamSize() const { return m_PrgRamSize; }
+
+	bool HasPrgRam() const { return m_HasPrgRam; }
+
+	// nullptr without a trainer, TRAINER_SIZE bytes otherwise
+	const u8* GetTrainer() const { return m_Trainer; }
+
+	MirrorMode GetMirrorMode() const { return m_MirrorMode; }
+
+	u8 GetMapperNumber() const { return m_MapperNumber; }
+
+	// True when the sections point into a file mapping rather than a copy
+	bool IsMapped() const { return m_Mapping.GetData() != nullptr; }
+
+private:
+	// Fills in the header fields and points the ROM sections into data
+	CartridgeLoadResult Parse(const u8* data, usize size);
+
+private:
+	// Whole file, the section pointers point into whichever one is used
+	MappedFile m_Mapping{};
+	std::unique_ptr<u8[]> m_Data = nullptr;
+
+	const u8* m_PrgRom = nullptr;
+	const u8* m_ChrRom = nullptr;
+	const u8* m_Trainer = nullptr;
+
+	usize m_PrgRomSize = 0;
+	usize m_ChrSize = 0;
+	usize m_PrgRamSize = 0;
+
+	MirrorMode m_MirrorMode = MirrorMode::Horizontal;
+	u8 m_MapperNumber = 0;
+
+	bool m_HasPrgRam = false;
+};
@@ -0,0 +1,42 @@
+#include "RunAhead.h"
+#include "NES.h"
+#include "../Core/Logger.h"
+
+RunAhead::RunAhead(usize stateSize, u32 frames) :
+	m_State(stateSize),
+	m_Frames{ frames }
+{
+
+}
+
+void RunAhead::StepFrame(NES& nes)
+{
+	if (m_Frames == 0)
+	{
+		nes.StepFrame();
+		return;
+	}
+
+	nes.SetVideoOutput(false);
+	nes.StepFrame();
+
+	if (nes.SaveState(m_State) != SaveStateResult::Success)
+	{
+		LOG_ERROR("Run-ahead couldn't save a %zu byte state, disabling it", m_State.size());
+		m_Frames = 0;
+		nes.SetVideoOutput(true);
+		return;
+	}
+
+	nes.SetAudioOutput(false);
+	for (u32 frame = 1; frame < m_Frames; frame++)
+	{
+		nes.StepFrame();
+	}
+
+	nes.SetVideoOutput(true);
+	nes.StepFrame();
+
+	nes.LoadState(m_State);
+	nes.SetAudioOutput(true);
+}
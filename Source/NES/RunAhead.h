@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <vector>
+
+class NES;
+
+// Hides input lag that games add themselves by showing the frame that
+// lies some frames ahead of the real one. Each call runs the real frame
+// with video off, saves, runs ahead with the same input, showing only the
+// last frame, then restores the real state. The framebuffer isn't part
+// of a save state, so it keeps the frame from ahead. Sound is the other
+// way round: only the real frame's is kept, the frames ahead are run
+// with audio off.
+class RunAhead
+{
+public:
+	RunAhead(usize stateSize, u32 frames = 1);
+
+	void SetFrames(u32 frames) { m_Frames = frames; }
+
+	u32 GetFrames() const { return m_Frames; }
+
+	// Stands in for NES::StepFrame. With 0 frames it is exactly that.
+	void StepFrame(NES& nes);
+
+private:
+	std::vector<u8> m_State{};
+	u32 m_Frames = 1;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../Core/Common.h"
+
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+// Bump whenever any Serialize function changes what it writes
+inline constexpr u16 SAVE_STATE_VERSION = 3;
+inline constexpr u32 SAVE_STATE_MAGIC = 0x5353454E; // "NESS"
+
+enum class SaveStateResult
+{
+	Success = 0,
+	BufferTooSmall,
+	InvalidHeader,
+	VersionMismatch,
+	CartridgeMismatch,
+	NoCartridge
+};
+
+// Leads every save state. The cartridge fields have to match the loaded
+// cartridge, since they decide the size of the RAM blocks that follow.
+struct SaveStateHeader
+{
+	u32 magic = SAVE_STATE_MAGIC;
+	u16 version = SAVE_STATE_VERSION;
+	u8 mapperNumber = 0;
+	u8 reserved = 0;
+	u32 prgRomSize = 0;
+	u32 chrSize = 0;
+	u32 prgRamSize = 0;
+	u32 stateSize = 0;
+};
+
+// Copies component state to or from a caller-owned buffer at a running
+// offset. Each component lists its state once in Serialize(StateArchive&)
+// and the same function saves, loads and measures it, so the layout is
+// fixed by the order of those calls and can't differ between directions.
+class StateArchive
+{
+public:
+	enum class Mode
+	{
+		Save,
+		Load,
+		// Only advances the offset, used to size buffers
+		Measure
+	};
+
+	// skipSharedMemory leaves out the RAM blocks that forks share instead
+	// of copying (CowMemory), which NES::Fork uses to move everything else
+	static StateArchive ForSave(std::span<u8> buffer, bool skipSharedMemory = false)
+	{
+		return { Mode::Save, buffer.data(), buffer.size(), skipSharedMemory };
+	}
+
+	static StateArchive ForLoad(std::span<const u8> buffer, bool skipSharedMemory = false)
+	{
+		// Never written through in Load mode
+		return { Mode::Load, const_cast<u8*>(buffer.data()), buffer.size(), skipSharedMemory };
+	}
+
+	static StateArchive ForMeasure(bool skipSharedMemory = false)
+	{
+		return { Mode::Measure, nullptr, 0, skipSharedMemory };
+	}
+
+	bool IsLoading() const { return m_Mode == Mode::Load; }
+
+	bool SkipsSharedMemory() const { return m_SkipSharedMemory; }
+
+	template <typename T>
+	void Value(T& val)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Save state values are copied as raw bytes");
+		Bytes(&val, sizeof(T));
+	}
+
+	void Bytes(void* data, usize size)
+	{
+		if (m_Mode != Mode::Measure)
+		{
+			if (m_Offset + size > m_Size)
+			{
+				m_Overflow = true;
+				return;
+			}
+			if (m_Mode == Mode::Save)
+			{
+				std::memcpy(m_Data + m_Offset, data, size);
+			}
+			else
+			{
+				std::memcpy(data, m_Data + m_Offset, size);
+			}
+		}
+		m_Offset += size;
+	}
+
+	usize GetOffset() const { return m_Offset; }
+
+	// Set when the buffer ran out. Nothing past that point was copied.
+	bool Overflowed() const { return m_Overflow; }
+
+private:
+	StateArchive(Mode mode, u8* data, usize size, bool skipSharedMemory) :
+		m_Mode{ mode }, m_Data{ data }, m_Size{ size }, m_SkipSharedMemory{ skipSharedMemory } {}
+
+private:
+	Mode m_Mode = Mode::Measure;
+	u8* m_Data = nullptr;
+	usize m_Size = 0;
+	usize m_Offset = 0;
+	bool m_Overflow = false;
+	bool m_SkipSharedMemory = false;
+};
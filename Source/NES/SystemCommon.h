@@ -1,6 +1,11 @@
 #pragma once
 
 inline constexpr usize WRAM_SIZE = 0x800;
+inline constexpr usize VRAM_SIZE = 0x800;
+// NTSC master clock of 21.477272 MHz divided by 12
+inline constexpr double CPU_CLOCK_RATE = 21.477272e6 / 12.0;
 inline constexpr usize SYSTEM_PALETTE_LENGTH = 0x40;
-
-using WRAM = Memory<WRAM_SIZE>;
\ No newline at end of file
+// Framebuffer pixels are (emphasis << 6) | palette index, emphasis being
+// the three PPUMASK color emphasis bits
+inline constexpr usize PIXEL_EMPHASIS_SHIFT = 6;
+inline constexpr usize EMPHASIS_PALETTE_LENGTH = SYSTEM_PALETTE_LENGTH << 3;
\ No newline at end of file